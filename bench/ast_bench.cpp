@@ -0,0 +1,110 @@
+//AST benchmark
+//Parses a generated Gehu script of about a million AST nodes into the pointer
+//tree and into the flat struct-of-arrays AST, then times parsing, semantic
+//analysis and a full traversal of each representation
+#include "../src/lexer.hpp"
+#include "../src/token_stream.hpp"
+#include "../src/parser.hpp"
+#include "../src/semantic_analyzer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+
+// about 40 nodes per round, with nested blocks and expressions a few
+// levels deep; the default makes about a million
+static std::string generateScript(size_t rounds) {
+    std::string script;
+    for (size_t i = 0; i < rounds; i++) {
+        std::string name = "value_" + std::to_string(i);
+        script += "let " + name + " = " + std::to_string(i) + " + 12 * (4 - 2) / 3;\n";
+        script += "if (" + name + " >= 100) {\n";
+        script += "    show \"large value\";\n";
+        script += "    " + name + " = " + name + " - 1.5 * " + name + ";\n";
+        script += "} else {\n";
+        script += "    let inner = (" + name + " + 1) * (" + name + " - 1);\n";
+        script += "    if (inner != 0) { show inner; }\n";
+        script += "    show " + name + ";\n";
+        script += "}\n";
+    }
+    return script;
+}
+
+static double bestOf(int runs, const std::function<void()>& body) {
+    double best = 0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? seconds : std::min(best, seconds);
+    }
+    return best * 1000.0;
+}
+
+// one read of every slot, the flat counterpart of countNodes
+static size_t countFlatNodes(const FlatAST& ast) {
+    size_t count = 0;
+    for (size_t node = 0; node < ast.size(); node++) {
+        count += ast.kinds[node] != FlatKind::Block || node != ast.root; // not the Program
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 25000;
+    const int runs = 5;
+    std::string source = generateScript(rounds);
+    StringInterner symbols;
+
+    // every run reparses into a fresh representation so the timings include
+    // allocation and teardown
+    size_t treeNodes = 0;
+    double treeParse = bestOf(runs, [&] {
+        Lexer lexer(source, symbols);
+        TokenStream tokens(lexer, source);
+        ASTContext context;
+        TreeBuilder builder(context);
+        Parser parser(tokens, builder);
+        treeNodes = countNodes(parser.parse());
+    });
+    size_t flatNodes = 0;
+    double flatParse = bestOf(runs, [&] {
+        Lexer lexer(source, symbols);
+        TokenStream tokens(lexer, source);
+        FlatAST ast;
+        ast.reserve(source.size() / 6); // as the driver does
+        FlatBuilder builder(ast);
+        FlatParser parser(tokens, builder);
+        parser.parse();
+        flatNodes = ast.size();
+    });
+
+    Lexer treeLexer(source, symbols);
+    TokenStream treeTokens(treeLexer, source);
+    ASTContext context;
+    TreeBuilder treeBuilder(context);
+    Program* program = Parser(treeTokens, treeBuilder).parse();
+
+    Lexer flatLexer(source, symbols);
+    TokenStream flatTokens(flatLexer, source);
+    FlatAST ast;
+    FlatBuilder flatBuilder(ast);
+    FlatParser(flatTokens, flatBuilder).parse();
+
+    SemanticAnalyzer analyzer(symbols);
+    double treeSema = bestOf(runs, [&] { analyzer.analyze(program); });
+    double flatSema = bestOf(runs, [&] { analyzer.analyze(ast); });
+    size_t visited = 0;
+    double treeWalk = bestOf(runs, [&] { visited = countNodes(program); });
+    double flatWalk = bestOf(runs, [&] { visited = countFlatNodes(ast); });
+
+    std::cout << "input:  " << source.size() / (1024.0 * 1024.0) << " MiB, " << treeNodes << " tree nodes, "
+              << flatNodes << " flat slots (" << visited << " nodes)" << std::endl;
+    std::cout << "best of " << runs << " (ms)     tree      flat" << std::endl;
+    std::cout << "lex+parse        " << treeParse << "    " << flatParse << std::endl;
+    std::cout << "sema             " << treeSema << "    " << flatSema << std::endl;
+    std::cout << "walk             " << treeWalk << "    " << flatWalk << std::endl;
+    return 0;
+}
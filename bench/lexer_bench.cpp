@@ -0,0 +1,94 @@
+//Lexer benchmark
+//Tokenizes a large generated Gehu script (or the files given on the command
+//line) several times and reports tokens per second and megabytes per second
+//-t <n> lexes in n parallel chunks with ParallelLexer
+#include "../src/lexer.hpp"
+#include "../src/parallel_lexer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// a few thousand statements per megabyte, covering every token kind
+static std::string generateScript(size_t targetBytes) {
+    std::string script;
+    script.reserve(targetBytes + 256);
+    size_t counter = 0;
+    while (script.size() < targetBytes) {
+        std::string name = "value_" + std::to_string(counter++);
+        script += "let " + name + " = " + std::to_string(counter * 37) + " + 12 * (4 - 2) / 3;\n";
+        script += "// comment line for " + name + "\n";
+        script += "if (" + name + " >= 100) {\n";
+        script += "    show \"large value\";\n";
+        script += "    " + name + " = " + name + " - 1;\n";
+        script += "} else {\n";
+        script += "    if (" + name + " != 0) { show " + name + " == 1; }\n";
+        script += "    show " + name + " <= 2;\n";
+        script += "}\n";
+    }
+    return script;
+}
+
+static size_t countTokens(const std::string& source, unsigned threads) {
+    StringInterner symbols;
+    if (threads > 1) {
+        ParallelLexer lexer(source, symbols, threads);
+        Token batch[256];
+        size_t count = 0;
+        size_t filled;
+        while ((filled = lexer.fill(batch, 256)) > 0) {
+            count += filled;
+        }
+        return count - 1; // not the EOF token
+    }
+    Lexer lexer(source, symbols);
+    size_t count = 0;
+    while (lexer.nextToken().type != TokenType::EOF_TOKEN) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    std::string source;
+    unsigned threads = 1;
+    int first = 1;
+    if (argc > 2 && std::string(argv[1]) == "-t") {
+        threads = std::atoi(argv[2]);
+        first = 3;
+    }
+    if (argc > first) {
+        for (int i = first; i < argc; i++) {
+            std::ifstream file(argv[i]);
+            if (!file) {
+                std::cerr << "Could not open file: " << argv[i] << std::endl;
+                return 1;
+            }
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            source += buffer.str();
+            source += "\n";
+        }
+    } else {
+        source = generateScript(16 * 1024 * 1024);
+    }
+
+    const int runs = 5;
+    double bestSeconds = 0;
+    size_t tokens = 0;
+    for (int run = 0; run < runs; run++) {
+        auto start = std::chrono::steady_clock::now();
+        tokens = countTokens(source, threads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bestSeconds = run == 0 ? seconds : std::min(bestSeconds, seconds);
+    }
+
+    std::cout << "input:    " << source.size() / (1024.0 * 1024.0) << " MiB, " << tokens << " tokens" << std::endl;
+    std::cout << "best of " << runs << ": " << bestSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "tokens/s: " << tokens / bestSeconds << std::endl;
+    std::cout << "MiB/s:    " << source.size() / (1024.0 * 1024.0) / bestSeconds << std::endl;
+    return 0;
+}
@@ -1 +1,74 @@
-// Remove all accept method definitions for AST nodes, as they are now defined inline in ast.hpp. 
\ No newline at end of file
+#include "ast.hpp"
+#include "ast_visitor.hpp"
+#include <vector>
+
+// counts every expression and statement node it visits; children are pushed
+// on work stacks rather than visited recursively, in no particular order
+class NodeCounter : public ASTVisitor<NodeCounter> {
+public:
+    size_t count = 0;
+    std::vector<Expression*> expressions;
+    std::vector<Statement*> statements;
+
+    void run() {
+        while (!expressions.empty() || !statements.empty()) {
+            if (!expressions.empty()) {
+                Expression* next = expressions.back();
+                expressions.pop_back();
+                visit(next);
+            } else {
+                Statement* next = statements.back();
+                statements.pop_back();
+                visit(next);
+            }
+        }
+    }
+
+    void visitStringLiteral(StringLiteral*) { count++; }
+    void visitNumberLiteral(NumberLiteral*) { count++; }
+    void visitIdentifier(Identifier*) { count++; }
+    void visitBinaryExpression(BinaryExpression* node) {
+        count++;
+        expressions.push_back(node->left);
+        expressions.push_back(node->right);
+    }
+    void visitUnaryExpression(UnaryExpression* node) {
+        count++;
+        expressions.push_back(node->operand);
+    }
+    void visitBlock(Block* node) {
+        count++;
+        for (const auto& statement : node->statements) {
+            statements.push_back(statement);
+        }
+    }
+    void visitIfStatement(IfStatement* node) {
+        count++;
+        expressions.push_back(node->condition);
+        statements.push_back(node->thenBlock);
+        if (node->elseBlock) {
+            statements.push_back(node->elseBlock);
+        }
+    }
+    void visitVariableDeclaration(VariableDeclaration* node) {
+        count++;
+        expressions.push_back(node->value);
+    }
+    void visitShowStatement(ShowStatement* node) {
+        count++;
+        expressions.push_back(node->expression);
+    }
+    void visitAssignmentStatement(AssignmentStatement* node) {
+        count++;
+        expressions.push_back(node->value);
+    }
+};
+
+size_t countNodes(Program* program) {
+    NodeCounter counter;
+    for (const auto& statement : program->statements) {
+        counter.statements.push_back(statement);
+    }
+    counter.run();
+    return counter.count;
+}
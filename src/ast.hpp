@@ -2,12 +2,12 @@
 #pragma once
 
 #include "ast_forward.hpp"
-#include "ast_visitor.hpp"
-#include <vector>
-#include <memory>
-#include <string>
+#include "ast_context.hpp" // nodes are created in an ASTContext
+#include "string_interner.hpp" // for Symbol
+#include <cstdint>
+#include <string_view>
 
-enum class BinaryOperator {
+enum class BinaryOperator : uint8_t {
     ADD,
     SUBTRACT,
     MULTIPLY,
@@ -17,113 +17,143 @@ enum class BinaryOperator {
     GREATER_EQUAL,
     LESS_EQUAL,
     EQUAL_EQUAL,
-    NOT_EQUAL
+    NOT_EQUAL,
+    MODULO,
+    BITWISE_AND,
+    BITWISE_OR,
+    BITWISE_XOR
 };
 
+enum class UnaryOperator : uint8_t {
+    NEGATE, // -x
+    NOT // !x, 1 if x is zero and 0 otherwise
+};
+
+// One tag per concrete node class; visitors switch on it (see ast_visitor.hpp)
+enum class NodeKind : uint8_t {
+    StringLiteral,
+    NumberLiteral,
+    Identifier,
+    BinaryExpression,
+    UnaryExpression,
+    Block,
+    IfStatement,
+    VariableDeclaration,
+    ShowStatement,
+    AssignmentStatement
+};
+
+// Nodes live in an ASTContext and are freed with it, never deleted, so the
+// bases have no virtual destructor and children are plain pointers. Nodes
+// have no virtual functions at all: the kind tag says what a node is.
 class Expression {
 public:
-    virtual ~Expression() = default;
-    virtual void accept(ASTVisitor& visitor) = 0;
+    const NodeKind nodeKind;
+protected:
+    explicit Expression(NodeKind nodeKind) : nodeKind(nodeKind) {}
+    ~Expression() = default;
 };
 
 class Statement {
 public:
-    virtual ~Statement() = default;
-    virtual void accept(ASTVisitor& visitor) = 0;
+    const NodeKind nodeKind;
+protected:
+    explicit Statement(NodeKind nodeKind) : nodeKind(nodeKind) {}
+    ~Statement() = default;
 };
 
 class StringLiteral : public Expression {
 public:
-    std::string value;
-    StringLiteral(const std::string& value) : value(value) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitStringLiteral(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::StringLiteral;
+    std::string_view value; // in the ASTContext
+    StringLiteral(std::string_view value) : Expression(classKind), value(value) {}
 };
 
 class NumberLiteral : public Expression {
 public:
-    int value;
-    NumberLiteral(int value) : value(value) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitNumberLiteral(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::NumberLiteral;
+    // the value as the lexer decoded it; only the member for kind is set
+    enum class Kind { Integer, Float };
+    Kind kind;
+    int64_t integer = 0;
+    double real = 0;
+    NumberLiteral(int64_t integer) : Expression(classKind), kind(Kind::Integer), integer(integer) {}
+    NumberLiteral(double real) : Expression(classKind), kind(Kind::Float), real(real) {}
 };
 
 class Identifier : public Expression {
 public:
-    std::string name;
-    Identifier(const std::string& name) : name(name) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitIdentifier(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::Identifier;
+    Symbol name;
+    Identifier(Symbol name) : Expression(classKind), name(name) {}
 };
 
 class BinaryExpression : public Expression {
 public:
-    std::unique_ptr<Expression> left;
+    static constexpr NodeKind classKind = NodeKind::BinaryExpression;
+    Expression* left;
     BinaryOperator op;
-    std::unique_ptr<Expression> right;
-    BinaryExpression(std::unique_ptr<Expression> left, BinaryOperator op, std::unique_ptr<Expression> right)
-        : left(std::move(left)), op(op), right(std::move(right)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitBinaryExpression(this);
-    }
+    Expression* right;
+    BinaryExpression(Expression* left, BinaryOperator op, Expression* right)
+        : Expression(classKind), left(left), op(op), right(right) {}
+};
+
+class UnaryExpression : public Expression {
+public:
+    static constexpr NodeKind classKind = NodeKind::UnaryExpression;
+    UnaryOperator op;
+    Expression* operand;
+    UnaryExpression(UnaryOperator op, Expression* operand)
+        : Expression(classKind), op(op), operand(operand) {}
 };
 
 class Block : public Statement {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
-    Block(std::vector<std::unique_ptr<Statement>> statements) : statements(std::move(statements)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitBlock(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::Block;
+    NodeList<Statement> statements;
+    Block(NodeList<Statement> statements) : Statement(classKind), statements(statements) {}
 };
 
 class IfStatement : public Statement {
 public:
-    std::unique_ptr<Expression> condition;
-    std::unique_ptr<Block> thenBlock;
-    std::unique_ptr<Block> elseBlock;
-    IfStatement(std::unique_ptr<Expression> condition, std::unique_ptr<Block> thenBlock, std::unique_ptr<Block> elseBlock)
-        : condition(std::move(condition)), thenBlock(std::move(thenBlock)), elseBlock(std::move(elseBlock)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitIfStatement(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::IfStatement;
+    Expression* condition;
+    Block* thenBlock;
+    Block* elseBlock; // null without an else
+    IfStatement(Expression* condition, Block* thenBlock, Block* elseBlock)
+        : Statement(classKind), condition(condition), thenBlock(thenBlock), elseBlock(elseBlock) {}
 };
 
 class VariableDeclaration : public Statement {
 public:
-    std::string name;
-    std::unique_ptr<Expression> value;
-    VariableDeclaration(const std::string& name, std::unique_ptr<Expression> value)
-        : name(name), value(std::move(value)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitVariableDeclaration(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::VariableDeclaration;
+    Symbol name;
+    Expression* value;
+    VariableDeclaration(Symbol name, Expression* value)
+        : Statement(classKind), name(name), value(value) {}
 };
 
 class ShowStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression;
-    ShowStatement(std::unique_ptr<Expression> expression) : expression(std::move(expression)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitShowStatement(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::ShowStatement;
+    Expression* expression;
+    ShowStatement(Expression* expression) : Statement(classKind), expression(expression) {}
 };
 
 class AssignmentStatement : public Statement {
 public:
-    std::string name;
-    std::unique_ptr<Expression> value;
-    AssignmentStatement(const std::string& name, std::unique_ptr<Expression> value)
-        : name(name), value(std::move(value)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitAssignmentStatement(this);
-    }
+    static constexpr NodeKind classKind = NodeKind::AssignmentStatement;
+    Symbol name;
+    Expression* value;
+    AssignmentStatement(Symbol name, Expression* value)
+        : Statement(classKind), name(name), value(value) {}
 };
 
 class Program {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
-}; 
+    NodeList<Statement> statements;
+    Program(NodeList<Statement> statements) : statements(statements) {}
+};
+
+// number of nodes in the tree, for --time-report
+size_t countNodes(Program* program);
@@ -0,0 +1,11 @@
+#include "ast_context.hpp"
+#include <cstring>
+
+std::string_view ASTContext::copyString(std::string_view text) {
+    if (text.empty()) {
+        return std::string_view();
+    }
+    char* copy = allocator.Allocate<char>(text.size());
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
@@ -0,0 +1,63 @@
+//ASTContext class definition
+//ASTContext owns every node of one program. Nodes, string literal text and
+//child lists are bump-allocated in 64 KiB slabs and released all at once
+//when the context goes away, without a destructor walk over the tree.
+#pragma once
+
+#include <llvm/Support/Allocator.h> // for BumpPtrAllocator
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// A fixed list of child nodes, stored in an ASTContext
+template <typename T>
+class NodeList {
+public:
+    NodeList() = default;
+    NodeList(T* const* items, size_t count) : items(items), count(count) {}
+
+    T* const* begin() const { return items; }
+    T* const* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* operator[](size_t index) const { return items[index]; }
+
+private:
+    T* const* items = nullptr;
+    size_t count = 0;
+};
+
+class ASTContext {
+public:
+    ASTContext() = default;
+    ASTContext(const ASTContext&) = delete;
+    ASTContext& operator=(const ASTContext&) = delete;
+
+    // nodes are never destroyed one by one, so they may not own memory
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "AST nodes live in the arena and must not need a destructor");
+        return new (allocator.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    std::string_view copyString(std::string_view text);
+
+    template <typename T>
+    NodeList<T> copyList(T* const* items, size_t count) {
+        if (count == 0) {
+            return NodeList<T>();
+        }
+        T** copy = allocator.Allocate<T*>(count);
+        std::copy(items, items + count, copy);
+        return NodeList<T>(copy, count);
+    }
+
+    size_t bytesAllocated() const { return allocator.getBytesAllocated(); } // for --time-report
+
+private:
+    llvm::BumpPtrAllocatorImpl<llvm::MallocAllocator, 64 * 1024> allocator;
+};
@@ -8,6 +8,7 @@ class StringLiteral;
 class NumberLiteral;
 class Identifier;
 class BinaryExpression;
+class UnaryExpression;
 class Block;
 class IfStatement;
 class VariableDeclaration;
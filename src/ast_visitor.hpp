@@ -1,17 +1,51 @@
 #pragma once
 
-#include "ast_forward.hpp"
+#include "ast.hpp"
 
+// Statically dispatched visitor: visit() switches on the node's kind tag and
+// calls Derived::visitX directly, so there is no virtual call per node and
+// the compiler can inline the visit methods into the switch.
+// ExpressionResult and StatementResult are what the visit methods return,
+// e.g. CodeGenerator returns the llvm::Value* of each expression.
+template <typename Derived, typename ExpressionResult = void, typename StatementResult = void>
 class ASTVisitor {
 public:
-    virtual ~ASTVisitor() = default;
-    virtual void visitStringLiteral(StringLiteral* node) = 0;
-    virtual void visitNumberLiteral(NumberLiteral* node) = 0;
-    virtual void visitIdentifier(Identifier* node) = 0;
-    virtual void visitBinaryExpression(BinaryExpression* node) = 0;
-    virtual void visitBlock(Block* node) = 0;
-    virtual void visitIfStatement(IfStatement* node) = 0;
-    virtual void visitVariableDeclaration(VariableDeclaration* node) = 0;
-    virtual void visitShowStatement(ShowStatement* node) = 0;
-    virtual void visitAssignmentStatement(AssignmentStatement* node) = 0;
-}; 
\ No newline at end of file
+    ExpressionResult visit(Expression* node) {
+        switch (node->nodeKind) {
+            case NodeKind::StringLiteral:
+                return derived().visitStringLiteral(static_cast<StringLiteral*>(node));
+            case NodeKind::NumberLiteral:
+                return derived().visitNumberLiteral(static_cast<NumberLiteral*>(node));
+            case NodeKind::Identifier:
+                return derived().visitIdentifier(static_cast<Identifier*>(node));
+            case NodeKind::BinaryExpression:
+                return derived().visitBinaryExpression(static_cast<BinaryExpression*>(node));
+            case NodeKind::UnaryExpression:
+                return derived().visitUnaryExpression(static_cast<UnaryExpression*>(node));
+            default:
+                break;
+        }
+        __builtin_unreachable(); // statement kinds are never Expressions
+    }
+
+    StatementResult visit(Statement* node) {
+        switch (node->nodeKind) {
+            case NodeKind::Block:
+                return derived().visitBlock(static_cast<Block*>(node));
+            case NodeKind::IfStatement:
+                return derived().visitIfStatement(static_cast<IfStatement*>(node));
+            case NodeKind::VariableDeclaration:
+                return derived().visitVariableDeclaration(static_cast<VariableDeclaration*>(node));
+            case NodeKind::ShowStatement:
+                return derived().visitShowStatement(static_cast<ShowStatement*>(node));
+            case NodeKind::AssignmentStatement:
+                return derived().visitAssignmentStatement(static_cast<AssignmentStatement*>(node));
+            default:
+                break;
+        }
+        __builtin_unreachable(); // expression kinds are never Statements
+    }
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
@@ -1,35 +1,89 @@
 #include "ast.hpp"
 #include "codegen.hpp"
 #include "errors.hpp"
+#include "trace.hpp"
 #include <llvm/IR/Verifier.h> // verify the LLVM IR
 #include <llvm/Support/TargetSelect.h> // select the target
-#include <llvm/ExecutionEngine/ExecutionEngine.h> // execute the LLVM IR
-#include <llvm/ExecutionEngine/GenericValue.h> // store the LLVM generic value
+#include <llvm/ExecutionEngine/Orc/LLJIT.h> // execute the LLVM IR
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h> // resolve host process symbols
 #include <llvm/Support/raw_ostream.h> // store the LLVM raw ostream
-#include <iostream> // for input and output
-#include <llvm/ExecutionEngine/SectionMemoryManager.h> // store the LLVM section memory manager
+#include <cstdarg> // for the captured printf
+#include <mutex> // for one-time target initialization
+#include <llvm/IR/LegacyPassManager.h> // run the object emission passes
+#include <llvm/MC/TargetRegistry.h> // look up the native target
+#include <llvm/Passes/PassBuilder.h> // build the optimization pipeline
+#include <llvm/Passes/StandardInstrumentations.h> // time trace spans for passes
+#include <llvm/Support/FileSystem.h> // temporary object files
+#include <llvm/Support/FileUtilities.h> // remove the temporary object
+#include <llvm/Support/Program.h> // invoke the system linker
+#include <llvm/Support/SmallVectorMemoryBuffer.h> // hold the emitted object
+#include <llvm/Support/TimeProfiler.h> // --time-trace spans
+#include <llvm/TargetParser/Host.h> // host triple and cpu
+
+// initialize the native target once per process, needed by both the JIT and
+// object emission, and shared by every batch worker
+void CodeGenerator::initializeNativeTarget() {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        GEHU_TRACE(CodeGen, Info, "Initializing native target...");
+        if (llvm::InitializeNativeTarget()) {
+            throw CodeGenError("Failed to initialize native target", 0, 0);
+        }
+        
+        GEHU_TRACE(CodeGen, Info, "Initializing native target asm printer...");
+        if (llvm::InitializeNativeTargetAsmPrinter()) {
+            throw CodeGenError("Failed to initialize native target asm printer", 0, 0);
+        }
+        
+        GEHU_TRACE(CodeGen, Info, "Initializing native target asm parser...");
+        if (llvm::InitializeNativeTargetAsmParser()) {
+            throw CodeGenError("Failed to initialize native target asm parser", 0, 0);
+        }
+    });
+}
+
+// map -O0..-O3 to the IR pipeline level
+static llvm::OptimizationLevel getOptimizationLevel(unsigned optLevel) {
+    switch (optLevel) {
+        case 0: return llvm::OptimizationLevel::O0;
+        case 1: return llvm::OptimizationLevel::O1;
+        case 2: return llvm::OptimizationLevel::O2;
+        default: return llvm::OptimizationLevel::O3;
+    }
+}
+
+// map -O0..-O3 to the backend level
+static llvm::CodeGenOptLevel getCodeGenOptLevel(unsigned optLevel) {
+    switch (optLevel) {
+        case 0: return llvm::CodeGenOptLevel::None;
+        case 1: return llvm::CodeGenOptLevel::Less;
+        case 2: return llvm::CodeGenOptLevel::Default;
+        default: return llvm::CodeGenOptLevel::Aggressive;
+    }
+}
 
 //CodeGenerator class constructor
-CodeGenerator::CodeGenerator() {
-    std::cout << "[CodeGen] Initializing LLVM context..." << std::endl;
-    context = std::make_unique<llvm::LLVMContext>();
+CodeGenerator::CodeGenerator(unsigned optLevel, llvm::LLVMContext* sharedContext)
+    : context(sharedContext), symbols(nullptr), optLevel(optLevel) {
     if (!context) {
-        throw CodeGenError("Failed to create LLVM context", 0, 0);
+        GEHU_TRACE(CodeGen, Debug, "Initializing LLVM context...");
+        ownedContext = std::make_unique<llvm::LLVMContext>();
+        context = ownedContext.get();
     }
     
-    std::cout << "[CodeGen] Creating module..." << std::endl;
+    GEHU_TRACE(CodeGen, Debug, "Creating module...");
     module = std::make_unique<llvm::Module>("gehu", *context);
     if (!module) {
         throw CodeGenError("Failed to create LLVM module", 0, 0);
     }
     
-    std::cout << "[CodeGen] Creating IR builder..." << std::endl;
+    GEHU_TRACE(CodeGen, Debug, "Creating IR builder...");
     builder = std::make_unique<llvm::IRBuilder<>>(*context);
     if (!builder) {
         throw CodeGenError("Failed to create IR builder", 0, 0);
     }
     
-    std::cout << "[CodeGen] Creating printf function..." << std::endl;
+    GEHU_TRACE(CodeGen, Debug, "Creating printf function...");
     createPrintfFunction();
 }
 
@@ -50,12 +104,74 @@ void CodeGenerator::createPrintfFunction() {
     );
 }
 
-void CodeGenerator::generate(Program* program) {
+void CodeGenerator::generate(Program* program, const StringInterner& symbols) {
     if (!program) {
         throw CodeGenError("Null program pointer", 0, 0);
     }
+    beginMain(symbols);
     
-    std::cout << "[CodeGen] Generating main function..." << std::endl;
+    size_t index = 0;
+    for (const auto& statement : program->statements) {
+        if (!statement) {
+            throw CodeGenError("Null statement pointer", 0, 0);
+        }
+        GEHU_TRACE(CodeGen, Debug, "Visiting top-level statement...");
+        llvm::TimeTraceScope statementScope("Statement", [&] { return "#" + std::to_string(index); });
+        work.push_back({Work::Kind::Statement, statement, 0, {}});
+        runWork(nullptr);
+        index++;
+    }
+    
+    builder->CreateRet(builder->getInt32(0));
+}
+
+void CodeGenerator::generate(const FlatAST& ast, const StringInterner& symbols) {
+    if (ast.root == FlatAST::none) {
+        throw CodeGenError("Flat AST has no root block", 0, 0);
+    }
+    beginMain(symbols);
+    
+    size_t index = 0;
+    for (const uint32_t* statement = ast.statementsBegin(ast.root); statement != ast.statementsEnd(ast.root); ++statement) {
+        GEHU_TRACE(CodeGen, Debug, "Generating top-level statement...");
+        llvm::TimeTraceScope statementScope("Statement", [&] { return "#" + std::to_string(index); });
+        work.push_back({Work::Kind::FlatStatement, nullptr, *statement, {}});
+        runWork(&ast);
+        index++;
+    }
+    
+    builder->CreateRet(builder->getInt32(0));
+}
+
+// Nested statements are generated from an explicit work stack, so if blocks
+// nested arbitrarily deep do not grow the native stack
+void CodeGenerator::runWork(const FlatAST* ast) {
+    while (!work.empty()) {
+        Work next = work.back();
+        work.pop_back();
+        switch (next.kind) {
+            case Work::Kind::Statement:
+                visit(next.statement);
+                break;
+            case Work::Kind::FlatStatement:
+                generateFlatStatement(*ast, next.flatStatement);
+                break;
+            case Work::Kind::BeginElse:
+                beginElse(next.blocks);
+                break;
+            case Work::Kind::EndIf:
+                endIf(next.blocks);
+                break;
+        }
+    }
+}
+
+// create main and point the builder at its entry block
+void CodeGenerator::beginMain(const StringInterner& symbols) {
+    this->symbols = &symbols;
+    variables.assign(symbols.size(), nullptr);
+    
+    GEHU_TRACE(CodeGen, Info, "Generating main function...");
     llvm::FunctionType* mainType = llvm::FunctionType::get(
         builder->getInt32Ty(),
         false
@@ -82,255 +198,656 @@ void CodeGenerator::generate(Program* program) {
     }
     
     builder->SetInsertPoint(entry);
-    
-    for (const auto& statement : program->statements) {
-        if (!statement) {
-            throw CodeGenError("Null statement pointer", 0, 0);
-        }
-        std::cout << "[CodeGen] Visiting top-level statement..." << std::endl;
-        statement->accept(*this);
-    }
-    
-    builder->CreateRet(builder->getInt32(0));
-    
+}
+
+void CodeGenerator::verify() {
     std::string error;
     llvm::raw_string_ostream errorStream(error);
     if (llvm::verifyModule(*module, &errorStream)) {
-        std::cerr << "[CodeGen] Module verification failed: " << error << std::endl;
         throw CodeGenError("Module verification failed: " + error, 0, 0);
     }
-    std::cout << "[CodeGen] Module verified successfully." << std::endl;
+    GEHU_TRACE(CodeGen, Info, "Module verified successfully.");
+}
 
-    // Write the generated LLVM IR to a file for debugging
+// Write the generated LLVM IR to a file for debugging
+void CodeGenerator::writeIR(const std::string& irFile) {
     std::error_code EC;
-    llvm::raw_fd_ostream out("output.ll", EC);
+    llvm::raw_fd_ostream out(irFile, EC);
     if (EC) {
         throw CodeGenError("Failed to open output file: " + EC.message(), 0, 0);
     }
     module->print(out, nullptr);
     out.flush();
-    std::cout << "[CodeGen] Generated LLVM IR written to output.ll" << std::endl;
+    GEHU_TRACE(CodeGen, Info, "Generated LLVM IR written to " << irFile);
 }
 
-void CodeGenerator::visitStringLiteral(StringLiteral* node) {
-    std::cout << "[CodeGen] StringLiteral: " << node->value << std::endl;
-    currentValue = builder->CreateGlobalStringPtr(node->value);
+llvm::Value* CodeGenerator::visitStringLiteral(StringLiteral* node) {
+    GEHU_TRACE(CodeGen, Debug, "StringLiteral: " << node->value);
+    return getGlobalString(std::string(node->value));
 }
 
-void CodeGenerator::visitNumberLiteral(NumberLiteral* node) {
-    std::cout << "[CodeGen] NumberLiteral: " << node->value << std::endl;
-    currentValue = builder->getInt32(node->value);
+llvm::Value* CodeGenerator::visitNumberLiteral(NumberLiteral* node) {
+    if (node->kind == NumberLiteral::Kind::Float) {
+        GEHU_TRACE(CodeGen, Debug, "NumberLiteral: " << node->real);
+        return llvm::ConstantFP::get(builder->getDoubleTy(), node->real);
+    }
+    GEHU_TRACE(CodeGen, Debug, "NumberLiteral: " << node->integer);
+    return builder->getInt64(node->integer);
 }
 
-void CodeGenerator::visitIdentifier(Identifier* node) {
-    std::cout << "[CodeGen] Identifier: " << node->name << std::endl;
-    if (variables.find(node->name) == variables.end()) {
-        std::cerr << "[CodeGen] Undefined variable: " << node->name << std::endl;
-        throw CodeGenError("Undefined variable: " + node->name, 0, 0);
-    }
-    currentValue = builder->CreateLoad(builder->getInt32Ty(), variables[node->name]);
+llvm::Value* CodeGenerator::visitIdentifier(Identifier* node) {
+    return emitLoad(node->name);
+}
+
+llvm::Value* CodeGenerator::emitLoad(Symbol name) {
+    GEHU_TRACE(CodeGen, Debug, "Identifier: " << symbols->spelling(name));
+    llvm::AllocaInst* variable = llvm::cast<llvm::AllocaInst>(getVariable(name));
+    return builder->CreateLoad(variable->getAllocatedType(), variable);
 }
 // for binary expression
-void CodeGenerator::visitBinaryExpression(BinaryExpression* node) {
-    std::cout << "[CodeGen] BinaryExpression: op=" << static_cast<int>(node->op) << std::endl;
-    node->left->accept(*this);
-    llvm::Value* left = currentValue;
-    node->right->accept(*this);
-    llvm::Value* right = currentValue;
-    switch (node->op) {
+llvm::Value* CodeGenerator::visitBinaryExpression(BinaryExpression* node) {
+    return generateExpression(node);
+}
+
+// Operators are evaluated in post-order from an explicit stack: a node is
+// pushed once to schedule its operands (left on top) and once more to apply
+// the operator to their values. Only leaves go through visit().
+llvm::Value* CodeGenerator::generateExpression(Expression* expression) {
+    values.clear();
+    expressionWork.clear();
+    expressionWork.push_back({expression, false});
+    while (!expressionWork.empty()) {
+        auto [node, operandsDone] = expressionWork.back();
+        expressionWork.pop_back();
+        switch (node->nodeKind) {
+            case NodeKind::BinaryExpression: {
+                BinaryExpression* binary = static_cast<BinaryExpression*>(node);
+                if (!operandsDone) {
+                    expressionWork.push_back({node, true});
+                    expressionWork.push_back({binary->right, false});
+                    expressionWork.push_back({binary->left, false});
+                    break;
+                }
+                llvm::Value* right = values.back();
+                values.pop_back();
+                values.back() = emitBinary(binary->op, values.back(), right);
+                break;
+            }
+            case NodeKind::UnaryExpression: {
+                UnaryExpression* unary = static_cast<UnaryExpression*>(node);
+                if (!operandsDone) {
+                    expressionWork.push_back({node, true});
+                    expressionWork.push_back({unary->operand, false});
+                    break;
+                }
+                values.back() = emitUnary(unary->op, values.back());
+                break;
+            }
+            default:
+                values.push_back(visit(node));
+                break;
+        }
+    }
+    return values.back();
+}
+
+llvm::Value* CodeGenerator::emitBinary(BinaryOperator op, llvm::Value* left, llvm::Value* right) {
+    GEHU_TRACE(CodeGen, Debug, "BinaryExpression: op=" << static_cast<int>(op));
+    left = widenComparison(left);
+    right = widenComparison(right);
+    // an integer mixed with a double is converted to double
+    bool isFloat = left->getType()->isDoubleTy() || right->getType()->isDoubleTy();
+    if (isFloat) {
+        left = toDouble(left);
+        right = toDouble(right);
+    }
+    switch (op) {
         case BinaryOperator::ADD:
-            currentValue = builder->CreateAdd(left, right);
-            break;
+            return isFloat ? builder->CreateFAdd(left, right) : builder->CreateAdd(left, right);
         case BinaryOperator::SUBTRACT:
-            currentValue = builder->CreateSub(left, right);
-            break;
+            return isFloat ? builder->CreateFSub(left, right) : builder->CreateSub(left, right);
         case BinaryOperator::MULTIPLY:
-            currentValue = builder->CreateMul(left, right);
-            break;
+            return isFloat ? builder->CreateFMul(left, right) : builder->CreateMul(left, right);
         case BinaryOperator::DIVIDE:
-            currentValue = builder->CreateSDiv(left, right);
-            break;
+            return isFloat ? builder->CreateFDiv(left, right) : builder->CreateSDiv(left, right);
         case BinaryOperator::GREATER_THAN:
-            currentValue = builder->CreateICmpSGT(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpOGT(left, right) : builder->CreateICmpSGT(left, right);
         case BinaryOperator::LESS_THAN:
-            currentValue = builder->CreateICmpSLT(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpOLT(left, right) : builder->CreateICmpSLT(left, right);
         case BinaryOperator::GREATER_EQUAL:
-            currentValue = builder->CreateICmpSGE(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpOGE(left, right) : builder->CreateICmpSGE(left, right);
         case BinaryOperator::LESS_EQUAL:
-            currentValue = builder->CreateICmpSLE(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpOLE(left, right) : builder->CreateICmpSLE(left, right);
         case BinaryOperator::EQUAL_EQUAL:
-            currentValue = builder->CreateICmpEQ(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpOEQ(left, right) : builder->CreateICmpEQ(left, right);
         case BinaryOperator::NOT_EQUAL:
-            currentValue = builder->CreateICmpNE(left, right);
-            break;
+            return isFloat ? builder->CreateFCmpUNE(left, right) : builder->CreateICmpNE(left, right);
+        case BinaryOperator::MODULO:
+            return isFloat ? builder->CreateFRem(left, right) : builder->CreateSRem(left, right);
+        case BinaryOperator::BITWISE_AND:
+        case BinaryOperator::BITWISE_OR:
+        case BinaryOperator::BITWISE_XOR:
+            if (isFloat) {
+                throw CodeGenError("Bitwise operator needs integer operands", 0, 0);
+            }
+            if (op == BinaryOperator::BITWISE_AND) {
+                return builder->CreateAnd(left, right);
+            }
+            return op == BinaryOperator::BITWISE_OR ? builder->CreateOr(left, right) : builder->CreateXor(left, right);
+    }
+    throw CodeGenError("Unknown binary operator", 0, 0);
+}
+
+llvm::Value* CodeGenerator::visitUnaryExpression(UnaryExpression* node) {
+    return generateExpression(node);
+}
+
+llvm::Value* CodeGenerator::emitUnary(UnaryOperator op, llvm::Value* operand) {
+    GEHU_TRACE(CodeGen, Debug, "UnaryExpression: op=" << static_cast<int>(op));
+    if (!operand->getType()->isIntegerTy() && !operand->getType()->isDoubleTy()) {
+        throw CodeGenError("Unary operator needs a number operand", 0, 0);
+    }
+    operand = widenComparison(operand);
+    bool isFloat = operand->getType()->isDoubleTy();
+    if (op == UnaryOperator::NOT) {
+        return isFloat ? builder->CreateFCmpOEQ(operand, llvm::ConstantFP::get(operand->getType(), 0.0))
+                       : builder->CreateICmpEQ(operand, llvm::ConstantInt::get(operand->getType(), 0));
     }
+    return isFloat ? builder->CreateFNeg(operand) : builder->CreateNeg(operand);
+}
+
+// A comparison result (i1) used as an operand counts as 0 or 1. It is
+// widened even when both operands are comparisons: in i1, true + true is 0
+// and a signed compare sees true as -1
+llvm::Value* CodeGenerator::widenComparison(llvm::Value* value) {
+    return value->getType()->isIntegerTy(1) ? builder->CreateZExt(value, builder->getInt64Ty()) : value;
+}
+
+llvm::Value* CodeGenerator::toDouble(llvm::Value* value) {
+    return value->getType()->isDoubleTy() ? value : builder->CreateSIToFP(value, builder->getDoubleTy());
 }
 // for block
 void CodeGenerator::visitBlock(Block* node) {
-    std::cout << "[CodeGen] Entering block with " << node->statements.size() << " statements." << std::endl;
-    for (const auto& statement : node->statements) {
-        statement->accept(*this);
+    GEHU_TRACE(CodeGen, Debug, "Entering block with " << node->statements.size() << " statements.");
+    for (size_t i = node->statements.size(); i > 0; i--) {
+        work.push_back({Work::Kind::Statement, node->statements[i - 1], 0, {}});
     }
-    std::cout << "[CodeGen] Exiting block." << std::endl;
 }
 // for if statement
 void CodeGenerator::visitIfStatement(IfStatement* node) {
-    std::cout << "[CodeGen] IfStatement: Generating condition..." << std::endl;
-    node->condition->accept(*this);
-    llvm::Value* condition = currentValue;
+    GEHU_TRACE(CodeGen, Debug, "IfStatement: Generating condition...");
+    IfBlocks blocks = beginIf(visit(node->condition));
+    // then block, else, else block, end, scheduled in reverse
+    work.push_back({Work::Kind::EndIf, nullptr, 0, blocks});
+    if (node->elseBlock) {
+        work.push_back({Work::Kind::Statement, node->elseBlock, 0, {}});
+    }
+    work.push_back({Work::Kind::BeginElse, nullptr, 0, blocks});
+    work.push_back({Work::Kind::Statement, node->thenBlock, 0, {}});
+}
+
+// branch on condition and continue in the then block
+CodeGenerator::IfBlocks CodeGenerator::beginIf(llvm::Value* condition) {
+    // a number is true when it is not zero, as in C
+    if (condition->getType()->isIntegerTy(64)) {
+        condition = builder->CreateICmpNE(condition, builder->getInt64(0), "ifcond");
+    } else if (condition->getType()->isDoubleTy()) {
+        condition = builder->CreateFCmpUNE(condition, llvm::ConstantFP::get(builder->getDoubleTy(), 0.0), "ifcond");
+    } else if (!condition->getType()->isIntegerTy(1)) {
+        throw CodeGenError("If condition must be a number or a comparison", 0, 0);
+    }
     llvm::Function* function = builder->GetInsertBlock()->getParent();
     llvm::BasicBlock* thenBlock = llvm::BasicBlock::Create(*context, "then", function);
-    llvm::BasicBlock* elseBlock = llvm::BasicBlock::Create(*context, "else", function);
-    llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "ifcont", function);
-    builder->CreateCondBr(condition, thenBlock, elseBlock);
+    IfBlocks blocks;
+    blocks.elseBlock = llvm::BasicBlock::Create(*context, "else", function);
+    blocks.mergeBlock = llvm::BasicBlock::Create(*context, "ifcont", function);
+    builder->CreateCondBr(condition, thenBlock, blocks.elseBlock);
     builder->SetInsertPoint(thenBlock);
-    std::cout << "[CodeGen] IfStatement: Generating then block..." << std::endl;
-    node->thenBlock->accept(*this);
-    builder->CreateBr(mergeBlock);
-    builder->SetInsertPoint(elseBlock);
-    if (node->elseBlock) {
-        std::cout << "[CodeGen] IfStatement: Generating else block..." << std::endl;
-        node->elseBlock->accept(*this);
-    }
-    builder->CreateBr(mergeBlock);
-    builder->SetInsertPoint(mergeBlock);
-    std::cout << "[CodeGen] IfStatement: Done." << std::endl;
+    return blocks;
+}
+
+void CodeGenerator::beginElse(const IfBlocks& blocks) {
+    builder->CreateBr(blocks.mergeBlock);
+    builder->SetInsertPoint(blocks.elseBlock);
+}
+
+void CodeGenerator::endIf(const IfBlocks& blocks) {
+    builder->CreateBr(blocks.mergeBlock);
+    builder->SetInsertPoint(blocks.mergeBlock);
 }
 // for variable declaration
 void CodeGenerator::visitVariableDeclaration(VariableDeclaration* node) {
-    std::cout << "[CodeGen] VariableDeclaration: " << node->name << std::endl;
-    node->value->accept(*this);
-    StringLiteral* strLit = dynamic_cast<StringLiteral*>(node->value.get());
-    if (strLit) {
-        // For string literals, store the global string pointer directly
-        llvm::Value* strPtr = builder->CreateGlobalStringPtr(strLit->value);
-        llvm::AllocaInst* alloca = builder->CreateAlloca(strPtr->getType(), nullptr, node->name);
-        builder->CreateStore(strPtr, alloca);
-        variables[node->name] = alloca;
-    } else {
-        // For non-string literals (e.g., numbers), allocate an integer
-        llvm::AllocaInst* alloca = builder->CreateAlloca(builder->getInt32Ty(), nullptr, node->name);
-        builder->CreateStore(currentValue, alloca);
-        variables[node->name] = alloca;
+    emitDeclaration(node->name, visit(node->value));
+}
+
+void CodeGenerator::emitDeclaration(Symbol name, llvm::Value* value) {
+    GEHU_TRACE(CodeGen, Debug, "VariableDeclaration: " << symbols->spelling(name));
+    if (value->getType()->isIntegerTy(1)) {
+        value = builder->CreateZExt(value, builder->getInt64Ty()); // a comparison is stored as 0 or 1
     }
+    // the variable takes the type of its initializer: i64, double or a string pointer
+    llvm::AllocaInst* alloca = createEntryBlockAlloca(value->getType(), symbols->spelling(name));
+    builder->CreateStore(value, alloca);
+    variables[name] = alloca;
 }
 // for show statement
 void CodeGenerator::visitShowStatement(ShowStatement* node) {
-    std::cout << "[CodeGen] ShowStatement" << std::endl;
-    StringLiteral* strLit = dynamic_cast<StringLiteral*>(node->expression.get());
-    NumberLiteral* numLit = dynamic_cast<NumberLiteral*>(node->expression.get());
-    Identifier* ident = dynamic_cast<Identifier*>(node->expression.get());
-    if (strLit) {
-        // Print string literal directly
-        llvm::Value* formatStr = builder->CreateGlobalStringPtr("%s\n");
-        llvm::Value* str = builder->CreateGlobalStringPtr(strLit->value);
-        std::vector<llvm::Value*> args = {formatStr, str};
+    GEHU_TRACE(CodeGen, Debug, "ShowStatement");
+    Expression* expression = node->expression;
+    switch (expression->nodeKind) {
+        case NodeKind::StringLiteral:
+            emitShowString(static_cast<StringLiteral*>(expression)->value);
+            break;
+        case NodeKind::NumberLiteral:
+            emitShowNumber(visitNumberLiteral(static_cast<NumberLiteral*>(expression)));
+            break;
+        case NodeKind::Identifier:
+            emitShowVariable(static_cast<Identifier*>(expression)->name);
+            break;
+        default:
+            throw CodeGenError("Unsupported expression in show statement", 0, 0);
+    }
+}
+
+// Print string literal directly
+void CodeGenerator::emitShowString(std::string_view text) {
+    llvm::Value* formatStr = getGlobalString("%s\n");
+    llvm::Value* str = getGlobalString(std::string(text));
+    std::vector<llvm::Value*> args = {formatStr, str};
+    builder->CreateCall(printfFunction, args);
+}
+
+// Print number
+void CodeGenerator::emitShowNumber(llvm::Value* value) {
+    llvm::Value* formatStr = getGlobalString(value->getType()->isDoubleTy() ? "%.15g\n" : "%lld\n");
+    std::vector<llvm::Value*> args = {formatStr, value};
+    builder->CreateCall(printfFunction, args);
+}
+
+void CodeGenerator::emitShowVariable(Symbol name) {
+    std::string spelling(symbols->spelling(name));
+    llvm::Value* varAlloca = getVariable(name);
+    llvm::AllocaInst* allocaInst = llvm::dyn_cast<llvm::AllocaInst>(varAlloca);
+    if (!allocaInst) {
+        throw CodeGenError("Variable is not an alloca instruction: " + spelling, 0, 0);
+    }
+    llvm::Type* varType = allocaInst->getAllocatedType();
+    GEHU_TRACE(CodeGen, Debug, "ShowStatement: Variable " << spelling
+        << (varType->isPointerTy() ? " is a string" : " is a number"));
+    
+    if (varType->isIntegerTy(64) || varType->isDoubleTy()) {
+        // Print number variable
+        llvm::Value* formatStr = getGlobalString(varType->isDoubleTy() ? "%.15g\n" : "%lld\n");
+        llvm::Value* val = builder->CreateLoad(varType, varAlloca);
+        std::vector<llvm::Value*> args = {formatStr, val};
         builder->CreateCall(printfFunction, args);
-    } else if (numLit) {
-        // Print number
-        llvm::Value* formatStr = builder->CreateGlobalStringPtr("%d\n");
-        llvm::Value* num = builder->getInt32(numLit->value);
-        std::vector<llvm::Value*> args = {formatStr, num};
+    } else if (varType->isPointerTy()) {
+        // Print string variable
+        llvm::Value* formatStr = getGlobalString("%s\n");
+        llvm::Value* val = builder->CreateLoad(varType, varAlloca);
+        std::vector<llvm::Value*> args = {formatStr, val};
         builder->CreateCall(printfFunction, args);
-    } else if (ident) {
-        if (variables.find(ident->name) == variables.end()) {
-            throw CodeGenError("Undefined variable: " + ident->name, 0, 0);
-        }
-        llvm::Value* varAlloca = variables[ident->name];
-        llvm::AllocaInst* allocaInst = llvm::dyn_cast<llvm::AllocaInst>(varAlloca);
-        if (!allocaInst) {
-            throw CodeGenError("Variable is not an alloca instruction: " + ident->name, 0, 0);
-        }
-        llvm::Type* varType = allocaInst->getAllocatedType();
-        std::cout << "[CodeGen] ShowStatement: Variable " << ident->name << " has type: ";
-        varType->print(llvm::errs());
-        std::cout << std::endl;
-        
-        if (varType->isIntegerTy(32)) {
-            // Print integer variable
-            llvm::Value* formatStr = builder->CreateGlobalStringPtr("%d\n");
-            llvm::Value* val = builder->CreateLoad(builder->getInt32Ty(), varAlloca);
-            std::vector<llvm::Value*> args = {formatStr, val};
-            builder->CreateCall(printfFunction, args);
-        } else if (varType->isPointerTy()) {
-            // Print string variable
-            llvm::Value* formatStr = builder->CreateGlobalStringPtr("%s\n");
-            llvm::Value* val = builder->CreateLoad(varType, varAlloca);
-            std::vector<llvm::Value*> args = {formatStr, val};
-            builder->CreateCall(printfFunction, args);
-        } else {
-            throw CodeGenError("Unsupported variable type in show statement: " + ident->name, 0, 0);
-        }
     } else {
-        throw CodeGenError("Unsupported expression in show statement", 0, 0);
+        throw CodeGenError("Unsupported variable type in show statement: " + spelling, 0, 0);
     }
 }
 // for assignment statement 
 void CodeGenerator::visitAssignmentStatement(AssignmentStatement* node) {
-    if (variables.find(node->name) == variables.end()) {
-        throw CodeGenError("Assignment to undeclared variable: " + node->name, 0, 0);
+    checkAssignable(node->name);
+    emitAssignment(node->name, visit(node->value));
+}
+
+void CodeGenerator::checkAssignable(Symbol name) {
+    if (!variables[name]) {
+        throw CodeGenError("Assignment to undeclared variable: " + std::string(symbols->spelling(name)), 0, 0);
     }
-    node->value->accept(*this);
-    builder->CreateStore(currentValue, variables[node->name]);
 }
-// for run  
-void CodeGenerator::run() {
-    std::cout << "[CodeGen] Initializing native target..." << std::endl;
-    if (llvm::InitializeNativeTarget()) {
-        throw CodeGenError("Failed to initialize native target", 0, 0);
+
+void CodeGenerator::emitAssignment(Symbol name, llvm::Value* value) {
+    llvm::AllocaInst* variable = llvm::cast<llvm::AllocaInst>(variables[name]);
+    llvm::Type* type = variable->getAllocatedType();
+    if (value->getType()->isIntegerTy(1)) {
+        value = builder->CreateZExt(value, builder->getInt64Ty());
     }
-    
-    std::cout << "[CodeGen] Initializing native target asm printer..." << std::endl;
-    if (llvm::InitializeNativeTargetAsmPrinter()) {
-        throw CodeGenError("Failed to initialize native target asm printer", 0, 0);
+    if (type->isDoubleTy() && value->getType()->isIntegerTy()) {
+        value = toDouble(value);
     }
-    
-    std::cout << "[CodeGen] Initializing native target asm parser..." << std::endl;
-    if (llvm::InitializeNativeTargetAsmParser()) {
-        throw CodeGenError("Failed to initialize native target asm parser", 0, 0);
+    if (value->getType() != type) {
+        throw CodeGenError("Type mismatch in assignment to " + std::string(symbols->spelling(name)), 0, 0);
+    }
+    builder->CreateStore(value, variable);
+}
+
+// Flat AST: if blocks go on the work stack; an expression is a post-order
+// run of slots evaluated left to right on a value stack
+void CodeGenerator::generateFlatStatement(const FlatAST& ast, uint32_t statement) {
+    switch (ast.kinds[statement]) {
+        case FlatKind::VariableDeclaration:
+            emitDeclaration(ast.symbol(statement), generateFlatExpression(ast, ast.lhs[statement]));
+            break;
+        case FlatKind::Assignment:
+            checkAssignable(ast.symbol(statement));
+            emitAssignment(ast.symbol(statement), generateFlatExpression(ast, ast.lhs[statement]));
+            break;
+        case FlatKind::Show: {
+            uint32_t expression = ast.lhs[statement];
+            switch (ast.kinds[expression]) {
+                case FlatKind::StringLiteral:
+                    emitShowString(ast.string(expression));
+                    break;
+                case FlatKind::IntegerLiteral:
+                case FlatKind::FloatLiteral:
+                    emitShowNumber(generateFlatExpression(ast, expression));
+                    break;
+                case FlatKind::Identifier:
+                    emitShowVariable(ast.symbol(expression));
+                    break;
+                default:
+                    throw CodeGenError("Unsupported expression in show statement", 0, 0);
+            }
+            break;
+        }
+        case FlatKind::If: {
+            IfBlocks blocks = beginIf(generateFlatExpression(ast, ast.lhs[statement]));
+            // as in visitIfStatement
+            work.push_back({Work::Kind::EndIf, nullptr, 0, blocks});
+            if (ast.payloads[statement] != FlatAST::none) {
+                scheduleFlatBlock(ast, static_cast<uint32_t>(ast.payloads[statement]));
+            }
+            work.push_back({Work::Kind::BeginElse, nullptr, 0, blocks});
+            scheduleFlatBlock(ast, ast.rhs[statement]);
+            break;
+        }
+        default:
+            throw CodeGenError("Unexpected node in statement list", 0, 0);
     }
+}
+
+void CodeGenerator::scheduleFlatBlock(const FlatAST& ast, uint32_t block) {
+    for (const uint32_t* statement = ast.statementsEnd(block); statement != ast.statementsBegin(block); --statement) {
+        work.push_back({Work::Kind::FlatStatement, nullptr, statement[-1], {}});
+    }
+}
+
+llvm::Value* CodeGenerator::generateFlatExpression(const FlatAST& ast, uint32_t expression) {
+    values.clear();
+    for (uint32_t node = ast.expressionStart(expression); node <= expression; node++) {
+        switch (ast.kinds[node]) {
+            case FlatKind::StringLiteral:
+                values.push_back(getGlobalString(std::string(ast.string(node))));
+                break;
+            case FlatKind::IntegerLiteral:
+                values.push_back(builder->getInt64(ast.integer(node)));
+                break;
+            case FlatKind::FloatLiteral:
+                values.push_back(llvm::ConstantFP::get(builder->getDoubleTy(), ast.real(node)));
+                break;
+            case FlatKind::Identifier:
+                values.push_back(emitLoad(ast.symbol(node)));
+                break;
+            case FlatKind::Unary:
+                values.back() = emitUnary(ast.unaryOperator(node), values.back());
+                break;
+            case FlatKind::Binary: {
+                llvm::Value* right = values.back();
+                values.pop_back();
+                values.back() = emitBinary(ast.ops[node], values.back(), right);
+                break;
+            }
+            default:
+                throw CodeGenError("Unexpected node in expression", 0, 0);
+        }
+    }
+    return values.back();
+}
+
+// output capture for JIT programs run on behalf of the compile server; the
+// program runs on the calling thread, so the buffer is per thread
+static thread_local std::string* captureBuffer = nullptr;
+
+static int capturePrintf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    char* text = nullptr;
+    int length = vasprintf(&text, format, args);
+    va_end(args);
+    if (length >= 0) {
+        captureBuffer->append(text, length);
+        free(text);
+    }
+    return length;
+}
+
+static int capturePuts(const char* str) {
+    captureBuffer->append(str);
+    captureBuffer->push_back('\n');
+    return 0;
+}
+
+static int capturePutchar(int c) {
+    captureBuffer->push_back(static_cast<char>(c));
+    return c;
+}
+
+// create the lazy JIT, with libc symbols resolved from the host process
+static std::unique_ptr<llvm::orc::LLLazyJIT> createJIT(unsigned optLevel, std::string* capturedOutput) {
+    CodeGenerator::initializeNativeTarget();
     
-    std::cout << "[CodeGen] Creating execution engine..." << std::endl;
+    GEHU_TRACE(JIT, Info, "Creating lazy JIT...");
+    llvm::Expected<llvm::orc::JITTargetMachineBuilder> targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+    if (!targetBuilder) {
+        throw CodeGenError("Failed to detect host target: " + llvm::toString(targetBuilder.takeError()), 0, 0);
+    }
+    targetBuilder->setCodeGenOptLevel(getCodeGenOptLevel(optLevel));
+
+    // functions are compiled on first call through compile-on-demand stubs
+    llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> jit = llvm::orc::LLLazyJITBuilder()
+        .setJITTargetMachineBuilder(std::move(*targetBuilder))
+        .create();
+    if (!jit) {
+        throw CodeGenError("Failed to create JIT: " + llvm::toString(jit.takeError()), 0, 0);
+    }
+
+    // Resolve printf (and anything else from libc) against the host process
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!generator) {
+        throw CodeGenError("Failed to create process symbol generator: " + llvm::toString(generator.takeError()), 0, 0);
+    }
+    (*jit)->getMainJITDylib().addGenerator(std::move(*generator));
+
+    if (capturedOutput) {
+        // printf and the calls the optimizer rewrites it into go to the capture buffer
+        llvm::orc::SymbolMap symbols;
+        llvm::JITSymbolFlags flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+        symbols[(*jit)->mangleAndIntern("printf")] = llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&capturePrintf), flags);
+        symbols[(*jit)->mangleAndIntern("puts")] = llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&capturePuts), flags);
+        symbols[(*jit)->mangleAndIntern("putchar")] = llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(&capturePutchar), flags);
+        if (llvm::Error error = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+            throw CodeGenError("Failed to define output capture symbols: " + llvm::toString(std::move(error)), 0, 0);
+        }
+    }
+    return std::move(*jit);
+}
+
+// look up main in the JIT and call it
+static void runMain(llvm::orc::LLJIT& jit, std::string* capturedOutput) {
+    GEHU_TRACE(JIT, Info, "Looking up main...");
+    llvm::Expected<llvm::orc::ExecutorAddr> mainSymbol = jit.lookup("main");
+    if (!mainSymbol) {
+        throw CodeGenError("Failed to find main function: " + llvm::toString(mainSymbol.takeError()), 0, 0);
+    }
+    int (*mainFunction)() = mainSymbol->toPtr<int (*)()>();
+
+    GEHU_TRACE(JIT, Info, "Executing main...");
+    captureBuffer = capturedOutput;
+    mainFunction();
+    captureBuffer = nullptr;
+}
+
+// for run  
+void CodeGenerator::run(std::string* capturedOutput) {
+    if (!ownedContext) {
+        // a shared context stays with its owner, so run a whole-module object instead
+        runObject(emitObject(), optLevel, capturedOutput);
+        return;
+    }
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit = createJIT(optLevel, capturedOutput);
+    llvm::orc::ThreadSafeModule threadSafeModule(std::move(module), std::move(ownedContext));
+    if (llvm::Error error = jit->addLazyIRModule(std::move(threadSafeModule))) {
+        throw CodeGenError("Failed to add module to JIT: " + llvm::toString(std::move(error)), 0, 0);
+    }
+    runMain(*jit, capturedOutput);
+}
+// for run object, e.g. one loaded from the compilation cache
+void CodeGenerator::runObject(std::unique_ptr<llvm::MemoryBuffer> object, unsigned optLevel, std::string* capturedOutput) {
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit = createJIT(optLevel, capturedOutput);
+    if (llvm::Error error = jit->addObjectFile(std::move(object))) {
+        throw CodeGenError("Failed to add object to JIT: " + llvm::toString(std::move(error)), 0, 0);
+    }
+    runMain(*jit, capturedOutput);
+}
+// for host triple, shared with the compilation cache key
+std::string CodeGenerator::getTargetTriple() {
+    return llvm::sys::getDefaultTargetTriple();
+}
+// for host cpu, shared with the compilation cache key
+std::string CodeGenerator::getTargetCPU() {
+    return llvm::sys::getHostCPUName().str();
+}
+// for target machine
+llvm::TargetMachine* CodeGenerator::getTargetMachine() {
+    if (targetMachine) {
+        return targetMachine.get();
+    }
+    initializeNativeTarget();
+
+    std::string triple = getTargetTriple();
     std::string error;
-    // Create a temporary unique_ptr for the module
-    std::unique_ptr<llvm::Module> tempModule = std::move(module);
-    llvm::EngineBuilder builder(std::move(tempModule));
-    builder.setErrorStr(&error);
-    builder.setVerifyModules(true);
-    builder.setOptLevel(llvm::CodeGenOptLevel::None);  // Disable optimizations for debugging
-    
-    llvm::ExecutionEngine* engine = builder.create();
-    if (!engine) {
-        throw CodeGenError("Failed to create execution engine: " + error, 0, 0);
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        throw CodeGenError("Failed to look up target " + triple + ": " + error, 0, 0);
+    }
+
+    llvm::TargetOptions options;
+    // PIC so the object links into the default position independent executable
+    targetMachine.reset(target->createTargetMachine(
+        triple, getTargetCPU(), "", options, llvm::Reloc::PIC_, std::nullopt,
+        getCodeGenOptLevel(optLevel)));
+    if (!targetMachine) {
+        throw CodeGenError("Failed to create target machine for " + triple, 0, 0);
+    }
+
+    module->setTargetTriple(triple);
+    module->setDataLayout(targetMachine->createDataLayout());
+    return targetMachine.get();
+}
+// for optimization
+void CodeGenerator::optimize() {
+    GEHU_TRACE(CodeGen, Info, "Running -O" << optLevel << " pipeline...");
+    llvm::LoopAnalysisManager LAM;
+    llvm::FunctionAnalysisManager FAM;
+    llvm::CGSCCAnalysisManager CGAM;
+    llvm::ModuleAnalysisManager MAM;
+
+    // one --time-trace span per pass and analysis; registers nothing when tracing is off
+    llvm::PassInstrumentationCallbacks instrumentation;
+    llvm::TimeProfilingPassesHandler timeProfiling;
+    timeProfiling.registerCallbacks(instrumentation);
+
+    // the target machine gives the pipeline cost models for inlining and vectorization
+    llvm::PassBuilder passBuilder(getTargetMachine(), llvm::PipelineTuningOptions(), std::nullopt, &instrumentation);
+    passBuilder.registerModuleAnalyses(MAM);
+    passBuilder.registerCGSCCAnalyses(CGAM);
+    passBuilder.registerFunctionAnalyses(FAM);
+    passBuilder.registerLoopAnalyses(LAM);
+    passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    llvm::OptimizationLevel level = getOptimizationLevel(optLevel);
+    llvm::ModulePassManager passes = level == llvm::OptimizationLevel::O0
+        ? passBuilder.buildO0DefaultPipeline(level)
+        : passBuilder.buildPerModuleDefaultPipeline(level);
+    passes.run(*module, MAM);
+}
+// for global string
+llvm::Value* CodeGenerator::getGlobalString(const std::string& value) {
+    auto it = globalStrings.find(value);
+    if (it != globalStrings.end()) {
+        return it->second;
+    }
+    llvm::Value* str = builder->CreateGlobalStringPtr(value);
+    globalStrings[value] = str;
+    return str;
+}
+// for entry block alloca, so mem2reg can promote variables declared in nested blocks
+llvm::AllocaInst* CodeGenerator::createEntryBlockAlloca(llvm::Type* type, llvm::StringRef name) {
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    llvm::IRBuilder<> entryBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
+    return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+// for variable lookup, an array load by symbol
+llvm::Value* CodeGenerator::getVariable(Symbol name) {
+    if (!variables[name]) {
+        throw CodeGenError("Undefined variable: " + std::string(symbols->spelling(name)), 0, 0);
+    }
+    return variables[name];
+}
+// for object in memory
+std::unique_ptr<llvm::MemoryBuffer> CodeGenerator::emitObject() {
+    if (!module) {
+        throw CodeGenError("No module to emit", 0, 0);
     }
+    llvm::TargetMachine* targetMachine = getTargetMachine();
 
-    // Register printf symbol for JIT
-    engine->addGlobalMapping("printf", (uint64_t)&printf);
+    GEHU_TRACE(CodeGen, Info, "Emitting object...");
+    llvm::SmallVector<char, 0> objectBytes;
+    llvm::raw_svector_ostream out(objectBytes);
+    llvm::legacy::PassManager passes;
+    if (targetMachine->addPassesToEmitFile(passes, out, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+        throw CodeGenError("Target machine cannot emit an object file", 0, 0);
+    }
+    llvm::TimeTraceScope emitScope("CodeGenPasses");
+    passes.run(*module);
+    return std::make_unique<llvm::SmallVectorMemoryBuffer>(std::move(objectBytes), "gehu.o", false);
+}
+// for object file
+void CodeGenerator::emitObjectFile(const std::string& filename) {
+    std::unique_ptr<llvm::MemoryBuffer> object = emitObject();
+    std::error_code EC;
+    llvm::raw_fd_ostream out(filename, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        throw CodeGenError("Failed to open object file: " + EC.message(), 0, 0);
+    }
+    out << object->getBuffer();
+}
+// for executable
+void CodeGenerator::emitExecutable(const std::string& filename) {
+    linkExecutable(*emitObject(), filename);
+}
+// for linking an object into an executable
+void CodeGenerator::linkExecutable(llvm::MemoryBufferRef object, const std::string& filename) {
+    llvm::SmallString<128> objectFile;
+    int fd;
+    if (std::error_code EC = llvm::sys::fs::createTemporaryFile("gehu", "o", fd, objectFile)) {
+        throw CodeGenError("Failed to create temporary object file: " + EC.message(), 0, 0);
+    }
+    llvm::FileRemover objectRemover(objectFile);
+    {
+        llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+        out << object.getBuffer();
+    }
 
-    std::cout << "[CodeGen] Getting main function pointer..." << std::endl;
-    llvm::Function* mainFunc = engine->FindFunctionNamed("main");
-    if (!mainFunc) {
-        delete engine;
-        throw CodeGenError("Failed to find main function", 0, 0);
+    // let the system compiler driver pick the crt files and libc for printf
+    llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName("cc");
+    if (!linker) {
+        throw CodeGenError("Could not find a system linker (cc) in PATH", 0, 0);
     }
-    
-    std::cout << "[CodeGen] Executing main..." << std::endl;
-    try {
-        // Use runFunction instead of getPointerToFunction
-        std::vector<llvm::GenericValue> noargs;
-        engine->runFunction(mainFunc, noargs);
-    } catch (const std::exception& e) {
-        delete engine;
-        throw CodeGenError("Exception during execution: " + std::string(e.what()), 0, 0);
-    } catch (...) {
-        delete engine;
-        throw CodeGenError("Unknown exception during execution", 0, 0);
+
+    GEHU_TRACE(CodeGen, Info, "Linking " << filename << " with " << *linker << "...");
+    llvm::SmallVector<llvm::StringRef, 4> args = {*linker, objectFile, "-o", filename};
+    std::string error;
+    int status = llvm::sys::ExecuteAndWait(*linker, args, {}, {}, 0, 0, &error);
+    if (status != 0) {
+        throw CodeGenError("Linking " + filename + " failed" + (error.empty() ? "" : ": " + error), 0, 0);
     }
-    
-    delete engine; // delete the execution engine
-} 
\ No newline at end of file
+}
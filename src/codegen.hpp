@@ -1,41 +1,110 @@
 #pragma once
 
 #include "ast_visitor.hpp"
+#include "flat_ast.hpp"
+#include "string_interner.hpp" // resolve symbols to variable names
 #include <llvm/IR/LLVMContext.h> // store the LLVM context
 #include <llvm/IR/Module.h> // store the LLVM module
 #include <llvm/IR/IRBuilder.h> // build the LLVM IR
 #include <llvm/IR/Verifier.h> // verify the LLVM IR
-#include <llvm/ExecutionEngine/ExecutionEngine.h> // execute the LLVM IR
-#include <llvm/ExecutionEngine/GenericValue.h> // store the LLVM generic value
+#include <llvm/Support/MemoryBuffer.h> // hold emitted objects
 #include <llvm/Support/TargetSelect.h> // select the target
-#include <map> // store the variables
-#include <string> // store the variable names
+#include <llvm/Target/TargetMachine.h> // native code emission
+#include <map> // store the string constants
+#include <string>
+#include <utility> // for the expression work stack
+#include <vector> // store the variables
 
-// inherit from ASTVisitor
-class CodeGenerator : public ASTVisitor {
+// inherit from ASTVisitor; expression visits return their value
+class CodeGenerator : public ASTVisitor<CodeGenerator, llvm::Value*> {
 public:
-    CodeGenerator();
-    void generate(Program* program);
-    void run();
+    // optLevel: 0-3, as in -O0..-O3; sharedContext: borrowed context (e.g. from
+    // the compile server's pool), null to give the generator its own
+    explicit CodeGenerator(unsigned optLevel = 0, llvm::LLVMContext* sharedContext = nullptr);
+    // generate builds the IR; the driver then runs verify and optimize,
+    // optionally writeIR, and finally one of the emit or run methods.
+    // symbols must be the interner the program's identifiers came from.
+    void generate(Program* program, const StringInterner& symbols);
+    void generate(const FlatAST& ast, const StringInterner& symbols); // same IR from the flat form
+    void verify();
+    void optimize(); // run the new pass manager pipeline for optLevel
+    void writeIR(const std::string& filename);
+    void run(std::string* capturedOutput = nullptr); // capturedOutput: receives the program's stdout
+    std::unique_ptr<llvm::MemoryBuffer> emitObject(); // relocatable object in memory
+    void emitObjectFile(const std::string& filename); // write a relocatable object
+    void emitExecutable(const std::string& filename); // write and link a native executable
+
+    // for objects that did not come from this generator (e.g. the compilation cache)
+    static void runObject(std::unique_ptr<llvm::MemoryBuffer> object, unsigned optLevel, std::string* capturedOutput = nullptr);
+    static void linkExecutable(llvm::MemoryBufferRef object, const std::string& filename);
+    static std::string getTargetTriple();
+    static std::string getTargetCPU();
+    static void initializeNativeTarget(); // once per process
 
     // Visitor methods
-    void visitStringLiteral(StringLiteral* node) override;
-    void visitNumberLiteral(NumberLiteral* node) override;
-    void visitIdentifier(Identifier* node) override;
-    void visitBinaryExpression(BinaryExpression* node) override;
-    void visitBlock(Block* node) override;
-    void visitIfStatement(IfStatement* node) override;
-    void visitVariableDeclaration(VariableDeclaration* node) override;
-    void visitShowStatement(ShowStatement* node) override;
-    void visitAssignmentStatement(AssignmentStatement* node) override;
+    llvm::Value* visitStringLiteral(StringLiteral* node);
+    llvm::Value* visitNumberLiteral(NumberLiteral* node);
+    llvm::Value* visitIdentifier(Identifier* node);
+    llvm::Value* visitBinaryExpression(BinaryExpression* node);
+    llvm::Value* visitUnaryExpression(UnaryExpression* node);
+    void visitBlock(Block* node);
+    void visitIfStatement(IfStatement* node);
+    void visitVariableDeclaration(VariableDeclaration* node);
+    void visitShowStatement(ShowStatement* node);
+    void visitAssignmentStatement(AssignmentStatement* node);
 
 private:
+    // shared by the visitor and the flat AST walk
+    struct IfBlocks {
+        llvm::BasicBlock* elseBlock;
+        llvm::BasicBlock* mergeBlock;
+    };
+    // pending step of the statement walk; see runWork
+    struct Work {
+        enum class Kind : uint8_t { Statement, FlatStatement, BeginElse, EndIf };
+        Kind kind;
+        Statement* statement; // Statement
+        uint32_t flatStatement; // FlatStatement
+        IfBlocks blocks; // BeginElse, EndIf
+    };
+    void runWork(const FlatAST* ast); // until the work stack is empty
+    llvm::Value* generateExpression(Expression* expression);
+    void beginMain(const StringInterner& symbols);
+    llvm::Value* emitLoad(Symbol name);
+    llvm::Value* emitBinary(BinaryOperator op, llvm::Value* left, llvm::Value* right);
+    llvm::Value* emitUnary(UnaryOperator op, llvm::Value* operand);
+    IfBlocks beginIf(llvm::Value* condition);
+    void beginElse(const IfBlocks& blocks);
+    void endIf(const IfBlocks& blocks);
+    void emitDeclaration(Symbol name, llvm::Value* value);
+    void checkAssignable(Symbol name); // before the value is generated
+    void emitAssignment(Symbol name, llvm::Value* value);
+    void emitShowString(std::string_view text);
+    void emitShowNumber(llvm::Value* value);
+    void emitShowVariable(Symbol name);
+    void generateFlatStatement(const FlatAST& ast, uint32_t statement);
+    void scheduleFlatBlock(const FlatAST& ast, uint32_t block);
+    llvm::Value* generateFlatExpression(const FlatAST& ast, uint32_t expression);
+
     void createPrintfFunction();
+    llvm::TargetMachine* getTargetMachine();
+    llvm::Value* getGlobalString(const std::string& value); // cached global string constant
+    llvm::AllocaInst* createEntryBlockAlloca(llvm::Type* type, llvm::StringRef name);
+    llvm::Value* getVariable(Symbol name); // the variable's alloca; throws if undeclared
+    llvm::Value* widenComparison(llvm::Value* value); // i1 to an i64 0 or 1
+    llvm::Value* toDouble(llvm::Value* value); // converts an i64 operand
     
-    std::unique_ptr<llvm::LLVMContext> context; // store the LLVM context
+    std::unique_ptr<llvm::LLVMContext> ownedContext; // store the LLVM context, unless it is shared
+    llvm::LLVMContext* context; // the LLVM context in use
     std::unique_ptr<llvm::Module> module; // store the LLVM module
     std::unique_ptr<llvm::IRBuilder<>> builder; // build the LLVM IR
     llvm::Function* printfFunction; // store the printf function
-    std::map<std::string, llvm::Value*> variables; // store the variables
-    llvm::Value* currentValue; // store the current value
+    const StringInterner* symbols; // set by generate
+    std::vector<llvm::Value*> variables; // allocas indexed by symbol, null until declared
+    std::vector<Work> work; // statement steps still to generate, next last
+    std::vector<std::pair<Expression*, bool>> expressionWork; // nodes to evaluate, and whether their operands are done
+    std::vector<llvm::Value*> values; // operand stack of expression evaluation
+    unsigned optLevel; // store the optimization level
+    std::unique_ptr<llvm::TargetMachine> targetMachine; // created on first use
+    std::map<std::string, llvm::Value*> globalStrings; // store the emitted string constants
 }; 
\ No newline at end of file
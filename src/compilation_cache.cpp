@@ -0,0 +1,85 @@
+#include "compilation_cache.hpp"
+#include "trace.hpp"
+#include <llvm/ADT/StringExtras.h> // for toHex
+#include <llvm/Config/llvm-config.h> // for LLVM_VERSION_STRING
+#include <llvm/Support/FileSystem.h> // for the cache directory and atomic rename
+#include <llvm/Support/Path.h> // for cache entry paths
+#include <llvm/Support/SHA256.h> // for the cache key
+#include <llvm/Support/raw_ostream.h> // for writing entries
+#include <cstdlib> // for getenv
+#include <iostream>
+
+#ifndef GEHU_VERSION
+#define GEHU_VERSION "unknown"
+#endif
+
+CompilationCache::CompilationCache(const std::string& directory) : directory(directory) {
+    if (std::error_code EC = llvm::sys::fs::create_directories(directory)) {
+        throw std::runtime_error("Could not create cache directory " + directory + ": " + EC.message());
+    }
+}
+
+std::string CompilationCache::directoryFromEnvironment() {
+    const char* directory = std::getenv("GEHU_CACHE_DIR");
+    return directory ? directory : "";
+}
+
+std::string CompilationCache::computeKey(llvm::StringRef source, unsigned optLevel, llvm::StringRef triple, llvm::StringRef cpu) {
+    llvm::SHA256 hasher;
+    // fields are separated by a NUL so no two different inputs hash the same bytes
+    auto addField = [&hasher](llvm::StringRef field) {
+        hasher.update(field);
+        hasher.update(llvm::StringRef("\0", 1));
+    };
+    addField(GEHU_VERSION);
+    addField(LLVM_VERSION_STRING);
+    addField(triple);
+    addField(cpu);
+    addField(std::to_string(optLevel));
+    hasher.update(source);
+    return llvm::toHex(hasher.final(), /*LowerCase=*/true);
+}
+
+std::string CompilationCache::pathFor(const std::string& key) const {
+    llvm::SmallString<256> path(directory);
+    llvm::sys::path::append(path, key + ".o");
+    return std::string(path.str());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CompilationCache::lookup(const std::string& key) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> object =
+        llvm::MemoryBuffer::getFile(pathFor(key), /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!object) {
+        GEHU_TRACE(Cache, Info, "Miss: " << key);
+        return nullptr;
+    }
+    GEHU_TRACE(Cache, Info, "Hit: " << key);
+    return std::move(*object);
+}
+
+void CompilationCache::store(const std::string& key, llvm::MemoryBufferRef object) {
+    // write to a unique temporary name and rename it into place, so concurrent
+    // runs never see a partially written entry
+    llvm::SmallString<256> tempPath;
+    int fd;
+    if (std::error_code EC = llvm::sys::fs::createUniqueFile(pathFor(key) + ".tmp-%%%%%%", fd, tempPath)) {
+        std::cerr << "[Cache] Could not create cache entry: " << EC.message() << std::endl;
+        return;
+    }
+    {
+        llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+        out << object.getBuffer();
+        if (out.has_error()) {
+            std::cerr << "[Cache] Could not write cache entry: " << out.error().message() << std::endl;
+            out.clear_error();
+            llvm::sys::fs::remove(tempPath);
+            return;
+        }
+    }
+    if (std::error_code EC = llvm::sys::fs::rename(tempPath, pathFor(key))) {
+        std::cerr << "[Cache] Could not store cache entry: " << EC.message() << std::endl;
+        llvm::sys::fs::remove(tempPath);
+        return;
+    }
+    GEHU_TRACE(Cache, Info, "Stored: " << key);
+}
@@ -0,0 +1,28 @@
+//CompilationCache class definition
+//CompilationCache stores native objects on disk, keyed by a hash of the
+//source bytes and every option that affects the generated code, so a rerun
+//of an unchanged script can skip the frontend and code generation entirely
+#pragma once
+
+#include <llvm/ADT/StringRef.h> // for source and triple views
+#include <llvm/Support/MemoryBuffer.h> // for cached objects
+#include <memory>
+#include <string>
+
+class CompilationCache {
+public:
+    explicit CompilationCache(const std::string& directory);
+
+    // $GEHU_CACHE_DIR, or an empty string when caching is not enabled
+    static std::string directoryFromEnvironment();
+    static std::string computeKey(llvm::StringRef source, unsigned optLevel, llvm::StringRef triple, llvm::StringRef cpu);
+
+    // null on a miss
+    std::unique_ptr<llvm::MemoryBuffer> lookup(const std::string& key);
+    void store(const std::string& key, llvm::MemoryBufferRef object);
+
+private:
+    std::string directory;
+
+    std::string pathFor(const std::string& key) const;
+};
@@ -0,0 +1,6 @@
+#include "compilation_session.hpp"
+
+const SourceBuffer& CompilationSession::addFile(const std::string& path) {
+    buffers.push_back(SourceBuffer::fromFile(path));
+    return *buffers.back();
+}
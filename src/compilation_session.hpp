@@ -0,0 +1,19 @@
+//CompilationSession class definition
+//A CompilationSession owns the source buffers of one compile. Every later
+//phase refers into them with string_views instead of copying, so a buffer
+//lives as long as the session that loaded it.
+#pragma once
+
+#include "source_buffer.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+class CompilationSession {
+public:
+    // load a file ("-" is standard input); throws std::runtime_error on failure
+    const SourceBuffer& addFile(const std::string& path);
+
+private:
+    std::vector<std::unique_ptr<SourceBuffer>> buffers;
+};
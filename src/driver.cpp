@@ -0,0 +1,247 @@
+#include "driver.hpp"
+#include "lexer.hpp"
+#include "pipelined_lexer.hpp"
+#include "parallel_lexer.hpp"
+#include "token_stream.hpp"
+#include "parser.hpp"
+#include "semantic_analyzer.hpp"
+#include "codegen.hpp"
+#include "errors.hpp"
+#include "compilation_cache.hpp"
+#include "compilation_session.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+#include <llvm/Support/FileSystem.h> // for the batch output directory
+#include <llvm/Support/Path.h> // for batch output names
+#include <atomic> // for the batch work queue
+#include <iostream>
+#include <map> // for duplicate batch outputs
+#include <mutex>
+#include <thread>
+
+std::string readFile(const std::string& filename) {
+    return std::string(SourceBuffer::fromFile(filename)->text());
+}
+
+// run the object, or link it when an output file was requested
+static void finishObject(std::unique_ptr<llvm::MemoryBuffer> object, const CompileOptions& options) {
+    if (!options.outputFile.empty()) {
+        PhaseProfiler::Scope phase(options.profiler, "link");
+        CodeGenerator::linkExecutable(*object, options.outputFile);
+        GEHU_TRACE(Driver, Info, "Executable written to " << options.outputFile);
+    } else if (options.execute) {
+        PhaseProfiler::Scope phase(options.profiler, "execute");
+        CodeGenerator::runObject(std::move(object), options.optLevel, options.capturedOutput);
+        GEHU_TRACE(Driver, Info, "Program execution finished.");
+    }
+}
+
+void compileSource(std::string_view source, const CompileOptions& options) {
+    PhaseProfiler* profiler = options.profiler;
+
+    // a cache hit skips every phase below and goes straight to the JIT or linker
+    std::unique_ptr<CompilationCache> cache;
+    std::string cacheKey;
+    if (!options.cacheDir.empty()) {
+        std::unique_ptr<llvm::MemoryBuffer> object;
+        {
+            PhaseProfiler::Scope phase(profiler, "cache lookup");
+            cache = std::make_unique<CompilationCache>(options.cacheDir);
+            cacheKey = CompilationCache::computeKey(source, options.optLevel,
+                CodeGenerator::getTargetTriple(), CodeGenerator::getTargetCPU());
+            object = cache->lookup(cacheKey);
+        }
+        if (object) {
+            finishObject(std::move(object), options);
+            return;
+        }
+    }
+    
+
+    // the parser pulls tokens from the lexer as it goes, so lexing and
+    // parsing are one phase
+    GEHU_TRACE(Driver, Info, "Starting lexing and parsing...");
+    StringInterner symbols;
+    ASTContext astContext; // every node, freed in one go at the end
+    Program* program = nullptr;
+    FlatAST flatAST; // used instead of program with --flat-ast
+    size_t tokenCount;
+    {
+        PhaseProfiler::Scope phase(profiler, "lex+parse");
+        std::unique_ptr<TokenProducer> lexer;
+        if (options.lexThreads > 1) {
+            lexer = std::make_unique<ParallelLexer>(source, symbols, options.lexThreads);
+        } else if (options.pipeline) {
+            lexer = std::make_unique<PipelinedLexer>(source, symbols);
+        } else {
+            lexer = std::make_unique<Lexer>(source, symbols);
+        }
+        TokenStream tokens(*lexer, source);
+        if (options.flatAST) {
+            flatAST.reserve(source.size() / 6); // typical code has a node every six bytes or so
+            FlatBuilder builder(flatAST);
+            FlatParser parser(tokens, builder);
+            parser.parse();
+        } else {
+            TreeBuilder builder(astContext);
+            Parser parser(tokens, builder);
+            program = parser.parse();
+        }
+        tokenCount = tokens.consumed() + 1; // and the EOF token
+    }
+    GEHU_TRACE(Driver, Info, "Parsing complete. Token count: " << tokenCount);
+    if (profiler) {
+        profiler->setCounter("tokens", tokenCount);
+        profiler->setCounter("symbols", symbols.size());
+        if (options.flatAST) {
+            profiler->setCounter("ast_nodes", flatAST.size());
+        } else {
+            profiler->setCounter("ast_nodes", countNodes(program));
+            profiler->setCounter("ast_bytes", astContext.bytesAllocated());
+        }
+    }
+    
+
+
+    GEHU_TRACE(Driver, Info, "Starting semantic analysis...");
+    {
+        PhaseProfiler::Scope phase(profiler, "sema");
+        SemanticAnalyzer analyzer(symbols);
+        if (options.flatAST) {
+            analyzer.analyze(flatAST);
+        } else {
+            analyzer.analyze(program);
+        }
+    }
+    GEHU_TRACE(Driver, Info, "Semantic analysis complete.");
+    
+
+
+    GEHU_TRACE(Driver, Info, "Starting code generation...");
+    CodeGenerator codegen(options.optLevel, options.context);
+    {
+        PhaseProfiler::Scope phase(profiler, "codegen");
+        if (options.flatAST) {
+            codegen.generate(flatAST, symbols);
+        } else {
+            codegen.generate(program, symbols);
+        }
+    }
+    {
+        PhaseProfiler::Scope phase(profiler, "verify");
+        codegen.verify();
+    }
+    {
+        PhaseProfiler::Scope phase(profiler, "optimize");
+        codegen.optimize();
+    }
+    if (!options.irFile.empty()) {
+        PhaseProfiler::Scope phase(profiler, "write ir");
+        codegen.writeIR(options.irFile);
+    }
+
+    if (cache) {
+        // whole-module object, so the next run can load it as is
+        std::unique_ptr<llvm::MemoryBuffer> object;
+        {
+            PhaseProfiler::Scope phase(profiler, "emit object");
+            object = codegen.emitObject();
+        }
+        cache->store(cacheKey, *object);
+        finishObject(std::move(object), options);
+    } else if (options.outputFile.empty() && !options.execute) {
+        // compile only: still run the backend so its errors are reported
+        PhaseProfiler::Scope phase(profiler, "emit object");
+        codegen.emitObject();
+        GEHU_TRACE(Driver, Info, "Code generation complete.");
+    } else if (!options.outputFile.empty()) {
+        GEHU_TRACE(Driver, Info, "Code generation complete. Building executable...");
+        PhaseProfiler::Scope phase(profiler, "emit and link");
+        codegen.emitExecutable(options.outputFile);
+        GEHU_TRACE(Driver, Info, "Executable written to " << options.outputFile);
+    } else {
+        GEHU_TRACE(Driver, Info, "Code generation complete. Running program...");
+        PhaseProfiler::Scope phase(profiler, "execute");
+        codegen.run(options.capturedOutput);
+        GEHU_TRACE(Driver, Info, "Program execution finished.");
+    }
+}
+
+// a.gehu -> a, placed in the -o directory when one was given
+static std::string batchOutputFile(const std::string& file, const std::string& outputDir) {
+    llvm::SmallString<256> output(outputDir);
+    if (output.empty()) {
+        output = file;
+        llvm::sys::path::replace_extension(output, "");
+    } else {
+        llvm::sys::path::append(output, llvm::sys::path::stem(file));
+    }
+    return std::string(output.str());
+}
+
+// the output names are checked before any worker starts: an output may not
+// overwrite its own source, and two files may not share an output, which the
+// workers would race on
+static std::vector<std::string> batchOutputFiles(const std::vector<std::string>& files, const std::string& outputDir) {
+    std::vector<std::string> outputs;
+    std::map<std::string, const std::string*> claimed; // absolute output path -> its source
+    for (const std::string& file : files) {
+        std::string output = batchOutputFile(file, outputDir);
+        if (output == file || llvm::sys::fs::equivalent(output, file)) {
+            throw std::runtime_error(file + ": the executable would overwrite the source file; "
+                                     "give it an extension or use -o <dir>");
+        }
+        llvm::SmallString<256> key(output);
+        llvm::sys::fs::make_absolute(key);
+        llvm::sys::path::remove_dots(key, true);
+        auto [previous, inserted] = claimed.emplace(std::string(key.str()), &file);
+        if (!inserted) {
+            throw std::runtime_error(*previous->second + " and " + file + " would both be written to " + output);
+        }
+        outputs.push_back(std::move(output));
+    }
+    return outputs;
+}
+
+size_t compileBatch(const std::vector<std::string>& files, const CompileOptions& options, unsigned jobs) {
+    std::vector<std::string> outputs = batchOutputFiles(files, options.outputFile);
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failures(0);
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++) {
+            const std::string& file = files[i];
+            CompileOptions fileOptions = options;
+            fileOptions.irFile.clear(); // workers would race on output.ll
+            fileOptions.profiler = nullptr; // phases of concurrent files would interleave
+            fileOptions.outputFile = outputs[i];
+
+            try {
+                CompilationSession session;
+                compileSource(session.addFile(file).text(), fileOptions);
+            } catch (const std::exception& e) {
+                failures++;
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::cerr << file << ": Error: " << e.what() << std::endl;
+            }
+        }
+    };
+
+    if (!options.outputFile.empty()) {
+        if (std::error_code EC = llvm::sys::fs::create_directories(options.outputFile)) {
+            throw std::runtime_error("Could not create output directory " + options.outputFile + ": " + EC.message());
+        }
+    }
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < jobs && i < files.size(); i++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    return failures;
+}
@@ -0,0 +1,39 @@
+//Driver functions
+//The compile pipeline (lexer -> parser -> semantic analyzer -> codegen -> JIT
+//or linker) shared by the command line, batch mode and the compile server
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class PhaseProfiler;
+
+namespace llvm {
+class LLVMContext;
+}
+
+struct CompileOptions {
+    unsigned optLevel = 0; // -O0 .. -O3
+    std::string outputFile; // -o; empty runs the program through the JIT
+    std::string cacheDir; // --cache-dir; empty disables the compilation cache
+    std::string irFile = "output.ll"; // LLVM IR dump; empty disables it
+    bool execute = true; // false compiles without running (when there is no outputFile)
+    std::string* capturedOutput = nullptr; // receives the program's stdout instead of the terminal
+    llvm::LLVMContext* context = nullptr; // borrowed context; null gives codegen its own
+    PhaseProfiler* profiler = nullptr; // --time-report; null records nothing
+    bool pipeline = false; // --pipeline: lex on a separate thread while parsing
+    unsigned lexThreads = 1; // --lex-threads: lex large sources in this many chunks at once
+    bool flatAST = false; // --flat-ast: parse into a FlatAST instead of the pointer tree
+};
+
+// the whole file as a string, for small inputs such as @manifests
+std::string readFile(const std::string& filename);
+
+// compile one program, then run it or link it to options.outputFile; source
+// is only borrowed (see CompilationSession)
+void compileSource(std::string_view source, const CompileOptions& options);
+
+// compile every file to an executable on a pool of worker threads, each with
+// its own LLVMContext; returns the number of files that failed
+size_t compileBatch(const std::vector<std::string>& files, const CompileOptions& options, unsigned jobs);
@@ -3,10 +3,18 @@
 #include <stdexcept>
 #include <string>
 
+// 1-based position in the source, recovered from a LineIndex
+struct SourceLocation {
+    size_t line;
+    size_t column;
+};
+
 class CompilerError : public std::runtime_error {
 public:
     CompilerError(const std::string& message, size_t line, size_t column)
         : std::runtime_error(message), line(line), column(column) {}
+    CompilerError(const std::string& message, SourceLocation location)
+        : CompilerError(message, location.line, location.column) {}
     
     size_t getLine() const { return line; }
     size_t getColumn() const { return column; }
@@ -20,22 +28,30 @@ class LexerError : public CompilerError {
 public:
     LexerError(const std::string& message, size_t line, size_t column)
         : CompilerError("Lexer error: " + message, line, column) {}
+    LexerError(const std::string& message, SourceLocation location)
+        : CompilerError("Lexer error: " + message, location) {}
 };
 
 class ParserError : public CompilerError {
 public:
     ParserError(const std::string& message, size_t line, size_t column)
         : CompilerError("Parser error: " + message, line, column) {}
+    ParserError(const std::string& message, SourceLocation location)
+        : CompilerError("Parser error: " + message, location) {}
 };
 
 class SemanticError : public CompilerError {
 public:
     SemanticError(const std::string& message, size_t line, size_t column)
         : CompilerError("Semantic error: " + message, line, column) {}
+    SemanticError(const std::string& message, SourceLocation location)
+        : CompilerError("Semantic error: " + message, location) {}
 };
 
 class CodeGenError : public CompilerError {
 public:
     CodeGenError(const std::string& message, size_t line, size_t column)
         : CompilerError("Code generation error: " + message, line, column) {}
+    CodeGenError(const std::string& message, SourceLocation location)
+        : CompilerError("Code generation error: " + message, location) {}
 }; 
\ No newline at end of file
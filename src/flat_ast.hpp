@@ -0,0 +1,99 @@
+//FlatAST class definition
+//FlatAST is the index-based alternative to the pointer tree (--flat-ast).
+//Every node is a slot in parallel arrays: its kind, operator, two 32-bit
+//child indices and a 64-bit payload. Expressions are stored in post-order,
+//so one expression is a contiguous run of slots ending at its root, and
+//SemanticAnalyzer and CodeGenerator evaluate it with a linear scan instead
+//of chasing pointers.
+#pragma once
+
+#include "ast.hpp" // for BinaryOperator and UnaryOperator
+#include "string_interner.hpp" // for Symbol
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class FlatKind : uint8_t {
+    StringLiteral,
+    IntegerLiteral,
+    FloatLiteral,
+    Identifier,
+    Binary,
+    Unary,
+    Block,
+    If,
+    VariableDeclaration,
+    Show,
+    Assignment
+};
+
+class FlatAST {
+public:
+    static constexpr uint32_t none = UINT32_MAX; // no node (an if without else)
+
+    // Slot contents by kind:
+    //   StringLiteral        payload: offset << 32 | length in strings
+    //   IntegerLiteral       payload: the value
+    //   FloatLiteral         payload: the bits of the double
+    //   Identifier           payload: symbol
+    //   Binary               lhs, rhs: operands; op; payload: first slot of the expression
+    //   Unary                lhs: operand; rhs: UnaryOperator; payload: first slot of the expression
+    //   Block                lhs: first entry in lists; rhs: number of statements
+    //   If                   lhs: condition; rhs: then block; payload: else block or none
+    //   VariableDeclaration  lhs: value; payload: symbol
+    //   Assignment           lhs: value; payload: symbol
+    //   Show                 lhs: expression
+    std::vector<FlatKind> kinds;
+    std::vector<BinaryOperator> ops;
+    std::vector<uint32_t> lhs;
+    std::vector<uint32_t> rhs;
+    std::vector<uint64_t> payloads;
+    std::vector<uint32_t> lists; // statement slots of every block, block by block
+    std::string strings; // string literal text
+    uint32_t root = none; // the Block of top-level statements
+
+    size_t size() const { return kinds.size(); }
+
+    // room for this many slots, to skip regrowing the arrays while parsing
+    void reserve(size_t slots) {
+        kinds.reserve(slots);
+        ops.reserve(slots);
+        lhs.reserve(slots);
+        rhs.reserve(slots);
+        payloads.reserve(slots);
+    }
+
+    uint32_t add(FlatKind kind, uint32_t left, uint32_t right, uint64_t payload,
+                 BinaryOperator op = BinaryOperator::ADD) {
+        kinds.push_back(kind);
+        ops.push_back(op);
+        lhs.push_back(left);
+        rhs.push_back(right);
+        payloads.push_back(payload);
+        return static_cast<uint32_t>(kinds.size() - 1);
+    }
+
+    // the first slot of the expression rooted at node
+    uint32_t expressionStart(uint32_t node) const {
+        bool isOperator = kinds[node] == FlatKind::Binary || kinds[node] == FlatKind::Unary;
+        return isOperator ? static_cast<uint32_t>(payloads[node]) : node;
+    }
+
+    UnaryOperator unaryOperator(uint32_t node) const { return static_cast<UnaryOperator>(rhs[node]); }
+    Symbol symbol(uint32_t node) const { return static_cast<Symbol>(payloads[node]); }
+    int64_t integer(uint32_t node) const { return static_cast<int64_t>(payloads[node]); }
+    double real(uint32_t node) const {
+        double value;
+        std::memcpy(&value, &payloads[node], sizeof(value));
+        return value;
+    }
+    std::string_view string(uint32_t node) const {
+        return std::string_view(strings).substr(payloads[node] >> 32, payloads[node] & UINT32_MAX);
+    }
+
+    // statement slots of a Block
+    const uint32_t* statementsBegin(uint32_t block) const { return lists.data() + lhs[block]; }
+    const uint32_t* statementsEnd(uint32_t block) const { return lists.data() + lhs[block] + rhs[block]; }
+};
@@ -0,0 +1,127 @@
+//Keyword table
+//The single list of Gehu keywords, shared by the lexer and by any tool that
+//needs the keyword set. Lookup goes through a perfect hash generated at
+//compile time from the table, so recognizing a keyword costs one hash, one
+//table probe and one comparison, and allocates nothing.
+#pragma once
+
+#include "lexer.hpp" //for TokenType
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace keywords {
+
+struct Keyword {
+    std::string_view spelling;
+    TokenType type;
+};
+
+// add new keywords here; the hash below is regenerated from this table
+inline constexpr Keyword table[] = {
+    {"let", TokenType::LET},
+    {"show", TokenType::SHOW},
+    {"if", TokenType::IF},
+    {"else", TokenType::ELSE},
+};
+
+inline constexpr size_t count = sizeof(table) / sizeof(table[0]);
+static_assert(count < 255, "keyword slots hold 8-bit table indices");
+
+namespace detail {
+
+constexpr size_t slotCountFor(size_t keywordCount) {
+    size_t slots = 1;
+    while (slots < keywordCount * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+inline constexpr size_t slotCount = slotCountFor(count);
+
+// mixes the length with the first and last characters, which already tell
+// most keywords apart; seed is searched for below so no two keywords collide
+constexpr uint32_t hash(std::string_view text, uint32_t seed) {
+    uint32_t first = static_cast<unsigned char>(text[0]);
+    uint32_t last = static_cast<unsigned char>(text[text.size() - 1]);
+    return (static_cast<uint32_t>(text.size()) * 31u + first * seed + last) & (slotCount - 1);
+}
+
+constexpr bool isPerfect(uint32_t seed) {
+    std::array<bool, slotCount> used{};
+    for (const Keyword& keyword : table) {
+        uint32_t slot = hash(keyword.spelling, seed);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 1; seed < 4096; seed++) {
+        if (isPerfect(seed)) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+inline constexpr uint32_t seed = findSeed();
+static_assert(seed != 0, "no perfect hash seed for the keyword table; widen the search or the slot count");
+
+// slot -> index into table, or count for an empty slot
+constexpr std::array<uint8_t, slotCount> buildSlots() {
+    std::array<uint8_t, slotCount> slots{};
+    for (size_t i = 0; i < slotCount; i++) {
+        slots[i] = static_cast<uint8_t>(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        slots[hash(table[i].spelling, seed)] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+inline constexpr std::array<uint8_t, slotCount> slots = buildSlots();
+
+constexpr size_t shortest() {
+    size_t length = table[0].spelling.size();
+    for (const Keyword& keyword : table) {
+        length = keyword.spelling.size() < length ? keyword.spelling.size() : length;
+    }
+    return length;
+}
+
+constexpr size_t longest() {
+    size_t length = 0;
+    for (const Keyword& keyword : table) {
+        length = keyword.spelling.size() > length ? keyword.spelling.size() : length;
+    }
+    return length;
+}
+
+inline constexpr size_t minLength = shortest();
+inline constexpr size_t maxLength = longest();
+
+} // namespace detail
+
+// the keyword's token type, or IDENTIFIER when text is not a keyword
+constexpr TokenType lookup(std::string_view text) {
+    if (text.size() < detail::minLength || text.size() > detail::maxLength) {
+        return TokenType::IDENTIFIER;
+    }
+    uint8_t index = detail::slots[detail::hash(text, detail::seed)];
+    if (index == count || table[index].spelling != text) {
+        return TokenType::IDENTIFIER;
+    }
+    return table[index].type;
+}
+
+static_assert(lookup("let") == TokenType::LET && lookup("else") == TokenType::ELSE
+    && lookup("lets") == TokenType::IDENTIFIER && lookup("x") == TokenType::IDENTIFIER,
+    "keyword lookup disagrees with the keyword table");
+
+} // namespace keywords
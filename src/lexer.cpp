@@ -2,243 +2,287 @@
 
 #include "errors.hpp" //for LexerError
 
-#include <cctype> //for isalpha, isdigit
+#include "trace.hpp" //for GEHU_TRACE
 
-#include <iostream>
+#include "keywords.hpp" //for keywords::lookup
 
+#include "line_index.hpp" //for error locations
 
+#include "simd_scan.hpp" //for the whitespace, comment and string kernels
 
-//Lexer class constructor
+#include <array> //for the character class table
 
-Lexer::Lexer(const std::string& source)
+#include <charconv> //for decoding number literals
 
-   : source(source), position(0), line(1), column(1) {}
+#include <utility> //for std::pair
 
 
 
-Token Lexer::nextToken() {
+// Every byte belongs to exactly one class, so the start state of the scanner
 
-   skipWhitespace();
+// is a single switch instead of a chain of comparisons and ctype calls
 
+enum class CharClass : unsigned char {
 
+   Invalid,
 
-   if (position >= source.length()) {
+   Space,
 
-       return makeToken(TokenType::EOF_TOKEN, "");
+   Newline,
 
-   }
+   Letter,
 
+   Digit,
 
+   Underscore,
 
-   // Skip comments
+   Quote,
 
-   if (current() == '/' && position + 1 < source.length() && source[position + 1] == '/') {
+   Slash,
 
-       // Skip until end of line
+   Operator, // may be followed by '=' (= == ! != > >= < <=)
 
-       while (position < source.length() && current() != '\n') {
+   Single // a one-character token (; + - * % & | ^ { } ( ))
 
-           advance();
+};
 
-       }
 
-       skipWhitespace();
 
-       if (position >= source.length()) {
+struct CharTable {
 
-           return makeToken(TokenType::EOF_TOKEN, "");
+   std::array<CharClass, 256> classes;
 
-       }
+   std::array<TokenType, 256> single; // token for Single, or Operator alone
 
-   }
+   std::array<TokenType, 256> withEquals; // token for Operator followed by '='
 
+};
 
 
-   char c = current();
 
+static constexpr CharTable buildCharTable() {
 
+   CharTable table{};
 
-   if (isalpha(c)) {
+   for (size_t c = 0; c < 256; c++) {
 
-       return scanIdentifier();
+       table.classes[c] = CharClass::Invalid;
 
-   }
+       table.single[c] = TokenType::ERROR;
 
+       table.withEquals[c] = TokenType::ERROR;
 
+   }
 
-   if (isdigit(c)) {
+   for (char c = 'a'; c <= 'z'; c++) {
 
-       return scanNumber();
+       table.classes[static_cast<unsigned char>(c)] = CharClass::Letter;
 
    }
 
+   for (char c = 'A'; c <= 'Z'; c++) {
+
+       table.classes[static_cast<unsigned char>(c)] = CharClass::Letter;
 
+   }
 
-   if (c == '"') {
+   for (char c = '0'; c <= '9'; c++) {
 
-       return scanString();
+       table.classes[static_cast<unsigned char>(c)] = CharClass::Digit;
 
    }
 
+   table.classes[' '] = CharClass::Space;
 
+   table.classes['\t'] = CharClass::Space;
 
-   if (c == '=') {
+   table.classes['\n'] = CharClass::Newline;
 
-       advance();
+   table.classes['_'] = CharClass::Underscore;
 
-       if (current() == '=') {
+   table.classes['"'] = CharClass::Quote;
 
-           advance();
+   table.classes['/'] = CharClass::Slash;
 
-           return makeToken(TokenType::EQUAL_EQUAL, "==");
 
-       }
 
-       return makeToken(TokenType::EQUALS, "=");
+   const std::pair<char, TokenType> singles[] = {
+
+       {';', TokenType::SEMICOLON}, {'+', TokenType::PLUS}, {'-', TokenType::MINUS},
+
+       {'*', TokenType::MULTIPLY}, {'%', TokenType::PERCENT}, {'&', TokenType::AMPERSAND},
+
+       {'|', TokenType::PIPE}, {'^', TokenType::CARET}, {'{', TokenType::LEFT_BRACE},
+
+       {'}', TokenType::RIGHT_BRACE}, {'(', TokenType::LEFT_PAREN}, {')', TokenType::RIGHT_PAREN}
+
+   };
+
+   for (const auto& entry : singles) {
+
+       table.classes[static_cast<unsigned char>(entry.first)] = CharClass::Single;
+
+       table.single[static_cast<unsigned char>(entry.first)] = entry.second;
 
    }
 
 
 
-   if (c == '!') {
+   const std::pair<char, TokenType> operators[][2] = {
 
-       advance();
+       {{'=', TokenType::EQUALS}, {'=', TokenType::EQUAL_EQUAL}},
 
-       if (current() == '=') {
+       {{'!', TokenType::BANG}, {'!', TokenType::NOT_EQUAL}},
 
-           advance();
+       {{'>', TokenType::GREATER_THAN}, {'>', TokenType::GREATER_EQUAL}},
 
-           return makeToken(TokenType::NOT_EQUAL, "!=");
+       {{'<', TokenType::LESS_THAN}, {'<', TokenType::LESS_EQUAL}}
 
-       }
+   };
+
+   for (const auto& entry : operators) {
 
-       throw LexerError("Expected '=' after '!'", line, column - 1);
+       unsigned char c = static_cast<unsigned char>(entry[0].first);
+
+       table.classes[c] = CharClass::Operator;
+
+       table.single[c] = entry[0].second;
+
+       table.withEquals[c] = entry[1].second;
 
    }
 
+   table.single['/'] = TokenType::DIVIDE;
 
+   return table;
 
-   if (c == '>') {
+}
 
-       advance();
 
-       if (current() == '=') {
 
-           advance();
+static constexpr CharTable charTable = buildCharTable();
 
-           return makeToken(TokenType::GREATER_EQUAL, ">=");
 
-       }
 
-       return makeToken(TokenType::GREATER_THAN, ">");
+static CharClass classOf(char c) {
 
-   }
+   return charTable.classes[static_cast<unsigned char>(c)];
 
+}
 
 
-   if (c == '<') {
 
-       advance();
+static bool isIdentifierPart(char c) {
 
-       if (current() == '=') {
+   CharClass charClass = classOf(c);
 
-           advance();
+   return charClass == CharClass::Letter || charClass == CharClass::Digit || charClass == CharClass::Underscore;
 
-           return makeToken(TokenType::LESS_EQUAL, "<=");
+}
 
-       }
 
-       return makeToken(TokenType::LESS_THAN, "<");
 
-   }
+static bool isBlank(char c) {
 
+   CharClass charClass = classOf(c);
 
+   return charClass == CharClass::Space || charClass == CharClass::Newline;
 
-   if (c == ';') {
+}
 
-       advance();
 
-       return makeToken(TokenType::SEMICOLON, ";");
 
-   }
+//Lexer class constructor
 
+Lexer::Lexer(std::string_view source, StringInterner& symbols)
 
+   : Lexer(source, symbols, 0, source.size()) {}
 
-   if (c == '+') {
 
-       advance();
 
-       return makeToken(TokenType::PLUS, "+");
+Lexer::Lexer(std::string_view source, StringInterner& symbols, size_t begin, size_t end)
+
+   : source(source), symbols(symbols), position(begin), end(end), done(false) {
+
+   if (source.size() > UINT32_MAX) {
+
+       throw LexerError("Source file larger than 4 GiB", 0, 0);
 
    }
 
+}
 
 
-   if (c == '-') {
 
-       advance();
+Token Lexer::nextToken() {
+
+   skipWhitespace();
+
 
-       return makeToken(TokenType::MINUS, "-");
+
+   if (position >= end) {
+
+       return makeToken(TokenType::EOF_TOKEN, position, 0);
 
    }
 
 
 
-   if (c == '*') {
+   size_t start = position;
 
-       advance();
+   char c = current();
 
-       return makeToken(TokenType::MULTIPLY, "*");
 
-   }
 
+   switch (classOf(c)) {
 
+   case CharClass::Letter:
 
-   if (c == '/') {
+       return scanIdentifier();
 
-       advance();
 
-       return makeToken(TokenType::DIVIDE, "/");
 
-   }
+   case CharClass::Digit:
 
+       return scanNumber();
 
 
-   if (c == '{') {
 
-       advance();
+   case CharClass::Quote:
 
-       return makeToken(TokenType::LEFT_BRACE, "{");
+       return scanString();
 
-   }
 
 
+   case CharClass::Single:
 
-   if (c == '}') {
+   case CharClass::Slash:
 
        advance();
 
-       return makeToken(TokenType::RIGHT_BRACE, "}");
-
-   }
+       return makeToken(charTable.single[static_cast<unsigned char>(c)], start, 1);
 
 
 
-   if (c == '(') {
+   case CharClass::Operator:
 
        advance();
 
-       return makeToken(TokenType::LEFT_PAREN, "(");
+       if (current() == '=') {
 
-   }
+           advance();
 
+           return makeToken(charTable.withEquals[static_cast<unsigned char>(c)], start, 2);
 
+       }
+
+       return makeToken(charTable.single[static_cast<unsigned char>(c)], start, 1);
 
-   if (c == ')') {
 
-       advance();
 
-       return makeToken(TokenType::RIGHT_PAREN, ")");
+   default:
+
+       break;
 
    }
 
@@ -246,9 +290,45 @@ Token Lexer::nextToken() {
 
    // Invalid character
 
-   char invalid = advance();
+   throw LexerError("Unexpected character: " + std::string(1, c), locate(start));
+
+}
+
 
-   throw LexerError("Unexpected character: " + std::string(1, invalid), line, column - 1);
+
+size_t Lexer::fill(Token* out, size_t max) {
+
+   size_t count = 0;
+
+   while (count < max && !done) {
+
+       size_t start = position;
+
+       try {
+
+           out[count] = nextToken();
+
+       } catch (const LexerError&) {
+
+           if (count == 0) {
+
+               throw;
+
+           }
+
+           position = start; // throw again on the next call
+
+           break;
+
+       }
+
+       done = out[count].type == TokenType::EOF_TOKEN;
+
+       count++;
+
+   }
+
+   return count;
 
 }
 
@@ -256,7 +336,7 @@ Token Lexer::nextToken() {
 
 bool Lexer::hasNext() const {
 
-   return position < source.length();
+   return position < end;
 
 }
 
@@ -276,41 +356,59 @@ char Lexer::advance() {
 
    position++;
 
-   column++;
-
    return c;
 
 }
 
 
 
+// Skips whitespace and // comments, including several comment lines in a row
+
 void Lexer::skipWhitespace() {
 
    while (position < source.length()) {
 
-       char c = current();
+       switch (classOf(current())) {
 
-       if (c == ' ' || c == '\t') {
+       case CharClass::Space:
 
-           advance();
+       case CharClass::Newline:
 
-           continue;
+           // a lone blank between tokens is cheaper to step over than to scan
 
-       }
+           if (position + 1 < source.length() && !isBlank(source[position + 1])) {
 
-       if (c == '\n') {
+               position++;
 
-           advance();
+               continue;
 
-           line++;
+           }
 
-           column = 1;
+           position += scan::skipWhitespace(source.data() + position, source.length() - position);
 
            continue;
 
-       }
 
-       break;
+
+       case CharClass::Slash:
+
+           if (position + 1 < source.length() && source[position + 1] == '/') {
+
+               position += scan::findByte(source.data() + position, source.length() - position, '\n');
+
+               continue;
+
+           }
+
+           return;
+
+
+
+       default:
+
+           return;
+
+       }
 
    }
 
@@ -318,11 +416,17 @@ void Lexer::skipWhitespace() {
 
 
 
-Token Lexer::makeToken(TokenType type, const std::string& value) {
+Token Lexer::makeToken(TokenType type, size_t start, size_t length) {
+
+   if (length > maxTokenLength) {
 
-   Token token(type, value, line, column);
+       throw LexerError("Token longer than 16 MiB", locate(start));
+
+   }
 
-   std::cout << "[Lexer] Token: " << value << " (Type: " << static_cast<int>(type) << ")" << std::endl;
+   Token token(type, static_cast<uint32_t>(start), static_cast<uint32_t>(length));
+
+   GEHU_TRACE(Lexer, Debug, "Token: " << source.substr(start, length) << " (Type: " << static_cast<int>(type) << ")");
 
    return token;
 
@@ -330,11 +434,21 @@ Token Lexer::makeToken(TokenType type, const std::string& value) {
 
 
 
+// Only diagnostics need a line and column, so the index is built on demand
+
+SourceLocation Lexer::locate(size_t offset) const {
+
+   return LineIndex(source).locate(offset);
+
+}
+
+
+
 Token Lexer::scanIdentifier() {
 
    size_t start = position;
 
-   while (position < source.length() && (isalnum(current()) || current() == '_')) {
+   while (position < source.length() && isIdentifierPart(current())) {
 
        advance();
 
@@ -342,105 +456,235 @@ Token Lexer::scanIdentifier() {
 
 
 
-   std::string text = source.substr(start, position - start);
-
+   std::string_view text = source.substr(start, position - start);
 
+   Token token = makeToken(keywords::lookup(text), start, text.size());
 
-   if (text == "let") {
+   if (token.type == TokenType::IDENTIFIER) {
 
-       return makeToken(TokenType::LET, text);
+       token.symbol = symbols.intern(text);
 
    }
 
-   if (text == "show") {
+   return token;
 
-       return makeToken(TokenType::SHOW, text);
+}
 
-   }
 
-   if (text == "if") {
 
-       return makeToken(TokenType::IF, text);
+// Value of c as a digit, or 16 when it is not a digit in any base
+
+static int digitValue(char c) {
+
+   if (c >= '0' && c <= '9') {
+
+       return c - '0';
 
    }
 
-   if (text == "else") {
+   char lower = static_cast<char>(c | 0x20);
 
-       return makeToken(TokenType::ELSE, text);
+   if (lower >= 'a' && lower <= 'f') {
+
+       return lower - 'a' + 10;
 
    }
 
+   return 16;
+
+}
+
+
+
+size_t Lexer::scanDigits(int base) {
+
+   size_t start = position;
+
+   while (position < source.length() && (digitValue(current()) < base || current() == '_')) {
 
+       advance();
 
-   return makeToken(TokenType::IDENTIFIER, text);
+   }
+
+   return position - start;
 
 }
 
 
 
+// Number literals are decoded here, once, into the token: 64-bit integers in
+
+// decimal, hex (0x) or binary (0b), and doubles with a fraction and/or an
+
+// exponent. '_' may separate digits. std::from_chars converts exactly.
+
 Token Lexer::scanNumber() {
 
    size_t start = position;
 
-   while (position < source.length() && isdigit(current())) {
+   auto invalid = [&]() {
+
+       while (isIdentifierPart(current())) {
+
+           advance();
+
+       }
+
+       return LexerError("Invalid number literal: " + std::string(source.substr(start, position - start)), locate(start));
+
+   };
+
+
+
+   int base = 10;
+
+   if (current() == '0' && position + 1 < source.length()) {
+
+       char prefix = static_cast<char>(source[position + 1] | 0x20);
+
+       base = prefix == 'x' ? 16 : prefix == 'b' ? 2 : 10;
+
+   }
+
+   if (base != 10) {
+
+       position += 2;
+
+   }
+
+   size_t digitsStart = position;
+
+   bool isFloat = false;
+
+   if (scanDigits(base) == 0) {
+
+       throw invalid();
+
+   }
+
+   if (base == 10 && current() == '.') {
+
+       isFloat = true;
 
        advance();
 
+       if (scanDigits(10) == 0) {
+
+           throw invalid();
+
+       }
+
    }
 
+   if (base == 10 && (current() | 0x20) == 'e') {
 
+       isFloat = true;
 
-   std::string text = source.substr(start, position - start);
+       advance();
 
-   return makeToken(TokenType::NUMBER_LITERAL, text);
+       if (current() == '+' || current() == '-') {
 
-}
+           advance();
 
+       }
 
+       if (scanDigits(10) == 0) {
 
-Token Lexer::scanString() {
+           throw invalid();
 
-   advance(); // Skip opening quote
+       }
 
-   size_t start = position;
+   }
+
+   if (isIdentifierPart(current())) {
+
+       throw invalid(); // 12abc, 0x1g, 0b102
+
+   }
+
+
+
+   // separators must sit between two digits; they are dropped before decoding
+
+   std::string_view digits = source.substr(digitsStart, position - digitsStart);
 
-   size_t startLine = line;
+   std::string stripped;
 
-   size_t startColumn = column;
+   if (digits.find('_') != std::string_view::npos) {
 
+       for (size_t i = 0; i < digits.size(); i++) {
 
+           if (digits[i] != '_') {
 
-   while (position < source.length() && current() != '"') {
+               stripped += digits[i];
 
-       if (current() == '\n') {
+           } else if (i == 0 || i + 1 == digits.size() || digitValue(digits[i - 1]) >= base || digitValue(digits[i + 1]) >= base) {
 
-           line++;
+               throw LexerError("Misplaced '_' in number literal", locate(digitsStart + i));
 
-           column = 1;
+           }
 
        }
 
-       advance();
+       digits = stripped;
 
    }
 
 
 
+   Token token = makeToken(isFloat ? TokenType::FLOAT_LITERAL : TokenType::NUMBER_LITERAL, start, position - start);
+
+   const char* first = digits.data();
+
+   const char* last = digits.data() + digits.size();
+
+   std::from_chars_result result = isFloat
+
+       ? std::from_chars(first, last, token.real)
+
+       : std::from_chars(first, last, token.integer, base);
+
+   if (result.ec == std::errc::result_out_of_range) {
+
+       throw LexerError("Number literal out of range: " + std::string(source.substr(start, position - start)), locate(start));
+
+   }
+
+   return token;
+
+}
+
+
+
+Token Lexer::scanString() {
+
+   advance(); // Skip opening quote
+
+   size_t start = position;
+
+
+
+   position += scan::findByte(source.data() + position, source.length() - position, '"');
+
+
+
    if (position >= source.length()) {
 
-       throw LexerError("Unterminated string literal", startLine, startColumn);
+       throw LexerError("Unterminated string literal", locate(start));
 
    }
 
 
 
-   std::string text = source.substr(start, position - start);
+   // the token spans the contents, without the quotes
+
+   size_t length = position - start;
 
    advance(); // Skip closing quote
 
 
 
-   return makeToken(TokenType::STRING_LITERAL, text);
+   return makeToken(TokenType::STRING_LITERAL, start, length);
 
 } 
 
@@ -20,15 +20,25 @@
 
 
 
+#include "errors.hpp" //for SourceLocation
+
+#include "string_interner.hpp" //for identifier symbols
+
+
+
+#include <cstdint>
+
 #include <string>
 
+#include <string_view>
+
 #include <vector>
 
 #include <memory>
 
 
 
-enum class TokenType {
+enum class TokenType : uint8_t {
 
    // Keywords
 
@@ -48,7 +58,9 @@ enum class TokenType {
 
    STRING_LITERAL,
 
-   NUMBER_LITERAL,
+   NUMBER_LITERAL, // 64-bit integer: 42, 1_000_000, 0xFF, 0b1010
+
+   FLOAT_LITERAL, // double: 1.5, 2e10, 6.02e-23
 
 
 
@@ -78,6 +90,16 @@ enum class TokenType {
 
    NOT_EQUAL,
 
+   PERCENT,
+
+   AMPERSAND,
+
+   PIPE,
+
+   CARET,
+
+   BANG,
+
 
 
    // Delimiters
@@ -102,29 +124,73 @@ enum class TokenType {
 
 
 
+// A token is a kind, a span of the source and a payload: the interned symbol
+
+// of an identifier, or the value of a number literal, decoded once by the
+
+// lexer. It packs into 16 bytes.
+
+// Its text is sliced from the source (see TokenStream::text), and its line
+
+// and column are recovered from a LineIndex only when a diagnostic needs them.
+
 struct Token {
 
-   TokenType type;
+   uint32_t offset = 0; // byte offset of the token text in the source
+
+   uint32_t length : 24; // tokens are limited to 16 MiB
+
+   TokenType type : 8;
+
+   union {
+
+       Symbol symbol; // IDENTIFIER
+
+       int64_t integer; // NUMBER_LITERAL
+
+       double real; // FLOAT_LITERAL
+
+   };
 
-   std::string value;
 
-   size_t line;
 
-   size_t column;
+   Token() : length(0), type(TokenType::ERROR), integer(0) {}
 
 
 
-   // Default constructor
+   Token(TokenType t, uint32_t o, uint32_t l)
 
-   Token() : type(TokenType::ERROR), line(0), column(0) {}
+       : offset(o), length(l), type(t), integer(0) {}
 
+};
+
+
+
+static_assert(sizeof(Token) == 16, "Token should pack into 16 bytes");
+
+
+
+static constexpr size_t maxTokenLength = (1u << 24) - 1;
+
+
+
+// Anything that can hand the parser tokens in batches, ending with EOF_TOKEN
+
+class TokenProducer {
+
+public:
+
+   virtual ~TokenProducer() = default;
+
+   // writes up to max tokens to out and returns how many; the last batch ends
 
+   // with the EOF token, and nothing is produced after it. An error is thrown
 
-   // Parameterized constructor
+   // only once the tokens before it have been returned, so the parser can
 
-   Token(TokenType t, const std::string& v, size_t l, size_t c)
+   // report an earlier mistake first.
 
-       : type(t), value(v), line(l), column(c) {}
+   virtual size_t fill(Token* out, size_t max) = 0;
 
 };
 
@@ -146,27 +212,41 @@ struct Token {
 
 //It also handles errors
 
-class Lexer {
+class Lexer : public TokenProducer {
 
 public:
 
-   explicit Lexer(const std::string& source);
+   // source is borrowed, not copied, and at most 4 GiB; identifiers are
+
+   // interned into symbols as they are scanned
+
+   Lexer(std::string_view source, StringInterner& symbols);
+
+   // lexes only the tokens that start in [begin, end), as used for one chunk
+
+   // of a parallel lex; a string literal may run on past end
+
+   Lexer(std::string_view source, StringInterner& symbols, size_t begin, size_t end);
 
    Token nextToken();
 
+   size_t fill(Token* out, size_t max) override;
+
    bool hasNext() const;
 
 
 
 private:
 
-   std::string source;
+   std::string_view source;
+
+   StringInterner& symbols;
 
    size_t position;
 
-   size_t line;
+   size_t end; // EOF_TOKEN is returned for tokens starting here or later
 
-   size_t column;
+   bool done; // fill has produced the EOF token
 
 
 
@@ -176,7 +256,9 @@ private:
 
    void skipWhitespace();
 
-   Token makeToken(TokenType type, const std::string& value);
+   Token makeToken(TokenType type, size_t start, size_t length);
+
+   SourceLocation locate(size_t offset) const; // for diagnostics only
 
    Token scanIdentifier();
 
@@ -184,5 +266,7 @@ private:
 
    Token scanNumber();
 
+   size_t scanDigits(int base); // digits of base and '_' separators
+
 }; 
 
@@ -0,0 +1,21 @@
+#include "line_index.hpp"
+#include "simd_scan.hpp" // find newlines a block at a time
+#include <algorithm> // for upper_bound
+
+LineIndex::LineIndex(std::string_view source) {
+    lineStarts.push_back(0);
+    size_t position = 0;
+    while (position < source.size()) {
+        position += scan::findByte(source.data() + position, source.size() - position, '\n');
+        if (position < source.size()) {
+            position++;
+            lineStarts.push_back(static_cast<uint32_t>(position));
+        }
+    }
+}
+
+SourceLocation LineIndex::locate(size_t offset) const {
+    // the last line starting at or before offset
+    auto line = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset) - 1;
+    return {static_cast<size_t>(line - lineStarts.begin()) + 1, offset - *line + 1};
+}
@@ -0,0 +1,19 @@
+//LineIndex class definition
+//LineIndex maps byte offsets in a source file to line and column numbers.
+//Tokens only store offsets, so the index is built once per file, and only
+//when a diagnostic actually needs a position.
+#pragma once
+
+#include "errors.hpp" //for SourceLocation
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class LineIndex {
+public:
+    explicit LineIndex(std::string_view source);
+    SourceLocation locate(size_t offset) const;
+
+private:
+    std::vector<uint32_t> lineStarts; // offset of the first byte of every line
+};
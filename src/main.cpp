@@ -1,80 +1,195 @@
-#include "lexer.hpp"
-#include "parser.hpp"
-#include "semantic_analyzer.hpp"
-#include "codegen.hpp"
+#include "driver.hpp"
 #include "errors.hpp"
-#include <fstream>
-#include <sstream> //String stream operations
+#include "compilation_cache.hpp"
+#include "compilation_session.hpp"
+#include "profiler.hpp"
+#include "server.hpp"
+#include "trace.hpp"
+#include <llvm/Support/TimeProfiler.h> // --time-trace
+#include <charconv> // for -j
 #include <iostream>
+#include <sstream> //String stream operations
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
+// expand @manifest arguments into the files they list, one per line
+static std::vector<std::string> expandManifests(const std::vector<std::string>& args) {
+    std::vector<std::string> files;
+    for (const std::string& arg : args) {
+        if (arg.size() > 1 && arg[0] == '@') {
+            std::istringstream manifest(readFile(arg.substr(1)));
+            std::string line;
+            while (std::getline(manifest, line)) {
+                if (!line.empty()) {
+                    files.push_back(line);
+                }
+            }
+        } else {
+            files.push_back(arg);
+        }
     }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    return files;
 }
 
+// upper bound for -j, well above any core count
+static const unsigned maxJobs = 1024;
+
 //Main function
 //argc: Argument count
 //argv: Argument vector
 //argv[0]: Program name
-//argv[1]: Source file name
-//argv[2]: Output file name
-//argv[3]: Error file name
-//argv[4]: Log file name
+//argv[1]: Source file name ("-" reads the program from standard input)
+//-o <file>: Compile to a native executable instead of running the program
+//-O0 .. -O3: Optimization level (default -O0)
+//--cache-dir <dir>: Reuse native objects from an on-disk cache (or set GEHU_CACHE_DIR)
+//--batch <files|@manifest>...: Compile many files to executables in parallel
+//  (-o names the output directory, -j the number of worker threads)
+//--trace[=<categories>]: Trace compiler internals (driver, lexer, parser, sema,
+//  codegen, jit, cache, server; category:info for phase messages only)
+//--trace-file <file>: Write trace output to a file instead of stderr
+//--time-report[=json]: Print per-phase time, memory and allocation figures to stderr
+//--time-trace=<file>: Write a Chrome trace-event timeline of the compile, LLVM passes included
+//--pipeline: Lex on a separate thread, overlapping lexing with parsing (large inputs)
+//--lex-threads=<n>: Lex large inputs in n chunks in parallel before parsing
+//--flat-ast: Parse into the flat index-based AST instead of the pointer tree
+//--serve <socket>: Run a resident compile server on a Unix domain socket
+//  (-j the number of connections served at once)
+//--client <socket>: Compile and run through a compile server
+//  (--compile-only skips running, --stats prints the server's counters;
+//  -o and --cache-dir are not supported)
 
 int main(int argc, char** argv) {
-    std::cout << "[main] Program started" << std::endl;
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <source_file>" << std::endl;
+    std::vector<std::string> sourceFiles;
+    CompileOptions options;
+    options.cacheDir = CompilationCache::directoryFromEnvironment();
+    bool batch = false;
+    unsigned jobs = 0;
+    bool usageError = false;
+    bool cacheDirGiven = false; // --cache-dir, as opposed to GEHU_CACHE_DIR
+    std::string serveSocket;
+    std::string clientSocket;
+    std::string clientCommand = "RUN";
+    PhaseProfiler profiler;
+    bool timeReport = false;
+    bool timeReportJSON = false;
+    std::string timeTraceFile;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            options.outputFile = argv[++i];
+        } else if (arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3') {
+            options.optLevel = arg[2] - '0';
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+            cacheDirGiven = true;
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "-j" && i + 1 < argc) {
+            // a thread count, checked like the -O level: anything else is a usage error
+            std::string_view count = argv[++i];
+            auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), jobs);
+            if (error != std::errc() || end != count.data() + count.size() || jobs == 0 || jobs > maxJobs) {
+                usageError = true;
+            }
+        } else if (arg == "--trace" || arg.compare(0, 8, "--trace=") == 0) {
+#ifdef GEHU_ENABLE_TRACING
+            if (!trace::enable(arg == "--trace" ? "all" : arg.substr(8))) {
+                std::cerr << "Error: Unknown trace category in " << arg << std::endl;
+                return 1;
+            }
+#else
+            std::cerr << "Warning: tracing is not compiled into this build" << std::endl;
+#endif
+        } else if (arg == "--trace-file" && i + 1 < argc) {
+            if (!trace::setOutputFile(argv[++i])) {
+                std::cerr << "Error: Could not open trace file " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if (arg == "--client" && i + 1 < argc) {
+            clientSocket = argv[++i];
+        } else if (arg == "--compile-only") {
+            clientCommand = "COMPILE";
+        } else if (arg == "--time-report" || arg == "--time-report=json") {
+            timeReport = true;
+            timeReportJSON = arg == "--time-report=json";
+            options.profiler = &profiler;
+        } else if (arg.compare(0, 13, "--time-trace=") == 0 && arg.size() > 13) {
+            timeTraceFile = arg.substr(13);
+        } else if (arg == "--pipeline") {
+            options.pipeline = true;
+        } else if (arg.compare(0, 14, "--lex-threads=") == 0 && arg.size() > 14) {
+            int threads = std::atoi(arg.c_str() + 14);
+            options.lexThreads = threads > 1 ? threads : 1;
+        } else if (arg == "--flat-ast") {
+            options.flatAST = true;
+        } else if (arg == "--stats") {
+            clientCommand = "STATS";
+        } else if (arg == "-" || (!arg.empty() && arg[0] != '-')) {
+            sourceFiles.push_back(arg);
+        } else {
+            usageError = true;
+        }
+    }
+    GEHU_TRACE(Driver, Info, "Program started");
+    if (!clientSocket.empty() && (!options.outputFile.empty() || cacheDirGiven)) {
+        // the server runs or compiles with its own settings and cannot send back an executable
+        std::cerr << "Error: -o and --cache-dir cannot be used with --client" << std::endl;
+        usageError = true;
+    }
+    if (!usageError && !serveSocket.empty() && sourceFiles.empty()) {
+        return runServer(serveSocket, jobs);
+    }
+    if (!usageError && !clientSocket.empty() && clientCommand == "STATS" && sourceFiles.empty()) {
+        return runClient(clientSocket, clientCommand, "", options.optLevel);
+    }
+    if (usageError || sourceFiles.empty() || (!batch && sourceFiles.size() != 1)) {
+        std::cerr << "Usage: " << argv[0] << " <source_file> [-o <output_file>] [-O0|-O1|-O2|-O3] [--cache-dir <dir>] [--trace[=<categories>]] [--time-report[=json]] [--time-trace=<file>] [--pipeline] [--lex-threads=<n>] [--flat-ast]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <source_file|@manifest>... [-o <output_dir>] [-j <jobs>] [-O0|-O1|-O2|-O3]" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve <socket> [-j <connections>]" << std::endl;
+        std::cerr << "       " << argv[0] << " --client <socket> <source_file> [--compile-only] [-O0|-O1|-O2|-O3]" << std::endl;
         return 1;
     }
     
     try {
-        std::cout << "[main] Reading source file..." << std::endl;
-        std::string source = readFile(argv[1]);
-        std::cout << "[main] Source file read successfully." << std::endl;
-        
+        if (batch) {
+            std::vector<std::string> files = expandManifests(sourceFiles);
+            size_t failures = compileBatch(files, options, jobs);
+            std::cout << "Batch complete: " << files.size() - failures << " of " << files.size()
+                      << " files compiled." << std::endl;
+            return failures == 0 ? 0 : 1;
+        }
 
-        std::cout << "[main] Starting lexical analysis..." << std::endl;
-        Lexer lexer(source);
-        std::vector<Token> tokens;
-        Token token;
-        do {
-            token = lexer.nextToken();
-            tokens.push_back(token);
-        } while (token.type != TokenType::EOF_TOKEN);
-        std::cout << "[main] Lexical analysis complete. Token count: " << tokens.size() << std::endl;
-        
-
-
-        std::cout << "[main] Starting parsing..." << std::endl;
-        Parser parser(tokens);
-        auto program = parser.parse();
-        std::cout << "[main] Parsing complete." << std::endl;
-        
-
-
-        std::cout << "[main] Starting semantic analysis..." << std::endl;
-        SemanticAnalyzer analyzer;
-        analyzer.analyze(program.get());
-        std::cout << "[main] Semantic analysis complete." << std::endl;
-        
-
-
-        std::cout << "[main] Starting code generation..." << std::endl;
-        CodeGenerator codegen;
-        codegen.generate(program.get());
-        std::cout << "[main] Code generation complete. Running program..." << std::endl;
-        codegen.run();
-        std::cout << "[main] Program execution finished." << std::endl;
-        
-
-        
+        if (!timeTraceFile.empty()) {
+            // granularity 0 keeps every span, however short
+            llvm::timeTraceProfilerInitialize(0, argv[0]);
+        }
+        GEHU_TRACE(Driver, Info, "Reading source file...");
+        CompilationSession session;
+        std::string_view source;
+        {
+            PhaseProfiler::Scope phase(options.profiler, "read");
+            source = session.addFile(sourceFiles[0]).text();
+        }
+        GEHU_TRACE(Driver, Info, "Source file read successfully.");
+        if (!clientSocket.empty()) {
+            return runClient(clientSocket, clientCommand, source, options.optLevel);
+        }
+        compileSource(source, options);
+        if (timeReport) {
+            if (timeReportJSON) {
+                profiler.printJSON(std::cerr);
+            } else {
+                profiler.printTable(std::cerr);
+            }
+        }
+        if (!timeTraceFile.empty()) {
+            llvm::Error error = llvm::timeTraceProfilerWrite(timeTraceFile, sourceFiles[0]);
+            llvm::timeTraceProfilerCleanup();
+            if (error) {
+                std::cerr << "Error: Could not write time trace: " << llvm::toString(std::move(error)) << std::endl;
+                return 1;
+            }
+        }
     } catch (const CompilerError& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
@@ -84,4 +199,4 @@ int main(int argc, char** argv) {
     }
     
     return 0;
-} 
\ No newline at end of file
+}
@@ -0,0 +1,121 @@
+#include "parallel_lexer.hpp"
+#include "simd_scan.hpp" //for finding chunk boundaries
+#include "trace.hpp" //for GEHU_TRACE
+#include <algorithm> //for std::min and std::max
+#include <functional> //for std::ref
+#include <thread>
+
+// end of a token in the source, including the closing quote of a string,
+// whose token covers only the contents
+static size_t tokenEnd(const Token& token) {
+    size_t end = token.offset + token.length;
+    return token.type == TokenType::STRING_LITERAL ? end + 1 : end;
+}
+
+void ParallelLexer::lexChunk(std::string_view source, Chunk& chunk) {
+    chunk.tokens.clear();
+    chunk.tokens.reserve((chunk.end - chunk.begin) / 4); // about one token per 4-5 bytes in practice
+    chunk.error = nullptr;
+    try {
+        Lexer lexer(source, chunk.symbols, chunk.begin, chunk.end);
+        for (Token token = lexer.nextToken(); token.type != TokenType::EOF_TOKEN; token = lexer.nextToken()) {
+            chunk.tokens.push_back(token);
+        }
+    } catch (...) {
+        chunk.error = std::current_exception();
+    }
+}
+
+ParallelLexer::ParallelLexer(std::string_view source, StringInterner& symbols, unsigned threads)
+    : chunkIndex(0), tokenIndex(0), sourceSize(static_cast<uint32_t>(source.size())), done(false), relexed(0) {
+    // Chunks begin just after a newline. Only string literals can span a
+    // line, so a chunk lexed on its own is right unless a string from an
+    // earlier chunk runs into it.
+    size_t count = std::max<size_t>(1, std::min<size_t>(threads, source.size() / minChunkBytes));
+    chunks.resize(count);
+    size_t begin = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t end = source.size();
+        if (i + 1 < count) {
+            size_t target = std::max(begin, source.size() / count * (i + 1));
+            end = std::min(source.size(), target + scan::findByte(source.data() + target, source.size() - target, '\n') + 1);
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+    GEHU_TRACE(Lexer, Info, "Lexing " << source.size() << " bytes in " << count << " chunks");
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back(lexChunk, source, std::ref(chunks[i]));
+    }
+    lexChunk(source, chunks[0]);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // Fix-up: resume is where the last accepted token ended. A chunk that
+    // begins at or after it was lexed from the right state; one that begins
+    // before it started inside a string and is lexed again from resume.
+    size_t resume = 0;
+    for (size_t i = 0; i < count; i++) {
+        Chunk& chunk = chunks[i];
+        if (resume > chunk.begin) {
+            chunk.begin = std::min(resume, chunk.end);
+            chunk.symbols = StringInterner();
+            lexChunk(source, chunk); // no tokens when the string covers it all
+            relexed++;
+        }
+
+        // chunk symbols are numbered in order of first use, so interning them
+        // in order gives the same numbers as one sequential lexer
+        chunk.remap.resize(chunk.symbols.size());
+        for (Symbol local = 0; local < chunk.remap.size(); local++) {
+            chunk.remap[local] = symbols.intern(chunk.symbols.spelling(local));
+        }
+        if (!chunk.tokens.empty()) {
+            resume = tokenEnd(chunk.tokens.back());
+        }
+        if (chunk.error) {
+            chunks.resize(i + 1); // nothing after the first error is used
+            break;
+        }
+    }
+}
+
+size_t ParallelLexer::fill(Token* out, size_t max) {
+    size_t count = 0;
+    while (count < max && !done) {
+        if (chunkIndex == chunks.size()) {
+            out[count++] = Token(TokenType::EOF_TOKEN, sourceSize, 0);
+            done = true;
+            break;
+        }
+
+        Chunk& chunk = chunks[chunkIndex];
+        for (; count < max && tokenIndex < chunk.tokens.size(); tokenIndex++) {
+            Token token = chunk.tokens[tokenIndex];
+            if (token.type == TokenType::IDENTIFIER) {
+                token.symbol = chunk.remap[token.symbol];
+            }
+            out[count++] = token;
+        }
+        if (tokenIndex < chunk.tokens.size()) {
+            break; // out is full
+        }
+
+        if (chunk.error) {
+            // as with Lexer, the tokens before the error go out first
+            if (count > 0) {
+                break;
+            }
+            done = true;
+            std::rethrow_exception(chunk.error);
+        }
+        std::vector<Token>().swap(chunk.tokens); // release chunks as they are consumed
+        chunkIndex++;
+        tokenIndex = 0;
+    }
+    return count;
+}
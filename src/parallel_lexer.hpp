@@ -0,0 +1,46 @@
+//ParallelLexer class definition
+//ParallelLexer tokenizes a large source on several threads (--lex-threads).
+//The source is cut into chunks at line boundaries and every chunk is lexed
+//on its own thread, on the guess that it does not start inside a string
+//literal. A sequential fix-up pass then re-lexes the few chunks where that
+//guess was wrong and merges the per-chunk symbol tables, so fill() hands out
+//exactly the tokens Lexer would have produced.
+#pragma once
+
+#include "lexer.hpp"
+#include <exception>
+#include <vector>
+
+class ParallelLexer : public TokenProducer {
+public:
+    // lexes the whole source before returning; sources below minChunkBytes per
+    // thread use fewer threads, down to a single chunk
+    ParallelLexer(std::string_view source, StringInterner& symbols, unsigned threads);
+
+    // the tokens before a lexer error are delivered before the error is thrown
+    size_t fill(Token* out, size_t max) override;
+
+    size_t chunkCount() const { return chunks.size(); }
+    size_t relexedChunks() const { return relexed; } // chunks the fix-up pass had to redo
+
+    static constexpr size_t minChunkBytes = 1 << 20;
+
+private:
+    struct Chunk {
+        size_t begin = 0;
+        size_t end = 0;
+        std::vector<Token> tokens; // offsets are into the whole source; no EOF token
+        StringInterner symbols; // symbols of tokens, numbered per chunk
+        std::vector<Symbol> remap; // chunk symbol -> symbol in the shared interner
+        std::exception_ptr error; // raised after tokens, if lexing failed
+    };
+
+    static void lexChunk(std::string_view source, Chunk& chunk);
+
+    std::vector<Chunk> chunks; // in source order, ending at the first error
+    size_t chunkIndex; // position of the next token for fill
+    size_t tokenIndex;
+    uint32_t sourceSize; // offset of the EOF token
+    bool done; // fill has produced the EOF token or thrown
+    size_t relexed;
+};
@@ -8,174 +8,268 @@
 //It also handles errors
 #include "parser.hpp"
 #include "errors.hpp"
+#include "trace.hpp"
+#include <array> // for the operator table
+#include <cstring> // for the bits of float literals
 #include <stdexcept>
-#include <iostream>
+#include <utility> // for std::pair
+
+//FlatBuilder appends; expressions come out in post-order because every
+//operand is built before the node that uses it
+uint32_t FlatBuilder::stringLiteral(std::string_view text) {
+    uint64_t offset = ast.strings.size();
+    ast.strings.append(text);
+    return ast.add(FlatKind::StringLiteral, 0, 0, offset << 32 | text.size());
+}
+
+uint32_t FlatBuilder::floatLiteral(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return ast.add(FlatKind::FloatLiteral, 0, 0, bits);
+}
+
+uint32_t FlatBuilder::block(const uint32_t* statements, size_t count) {
+    uint32_t first = static_cast<uint32_t>(ast.lists.size());
+    ast.lists.insert(ast.lists.end(), statements, statements + count);
+    return ast.add(FlatKind::Block, first, static_cast<uint32_t>(count), 0);
+}
+
 //Parser class constructor
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens), current(0) {}
+template <typename Builder>
+BasicParser<Builder>::BasicParser(TokenStream& tokens, Builder& builder) : tokens(tokens), builder(builder) {}
 
 
 //main
-std::unique_ptr<Program> Parser::parse() {
-    auto program = std::make_unique<Program>();
-    
-    while (!isAtEnd()) {
-        program->statements.push_back(parseStatement());
+// Statements are parsed in one loop. An if pushes an OpenIf and its block's
+// statements go on the shared pending stack; the block is handed to the
+// builder when its '}' arrives, so no block needs a vector of its own and
+// deeply nested ifs use no native stack
+template <typename Builder>
+typename Builder::ProgramRef BasicParser<Builder>::parse() {
+    pending.clear();
+    openIfs.clear();
+    while (true) {
+        if (!openIfs.empty() && (check(TokenType::RIGHT_BRACE) || isAtEnd())) {
+            closeBlock();
+        } else if (isAtEnd()) {
+            break;
+        } else if (match(TokenType::IF)) {
+            openIf();
+        } else {
+            StatementRef statement = parseStatement();
+            pending.push_back(statement);
+        }
     }
     
-    return program;
+    return builder.program(pending.data(), pending.size());
 }
 
-std::unique_ptr<Statement> Parser::parseStatement() {
+template <typename Builder>
+typename BasicParser<Builder>::StatementRef BasicParser<Builder>::parseStatement() {
     if (match(TokenType::LET)) {
         return parseVariableDeclaration();
     } else if (match(TokenType::SHOW)) {
         return parseShowStatement();
-    } else if (match(TokenType::IF)) {
-        return parseIfStatement();
     } else if (check(TokenType::IDENTIFIER)) {
         // Assignment statement
         return parseAssignmentStatement();
     }
-    throw ParserError("Unexpected token: " + peek().value, peek().line, peek().column);
+    throw ParserError("Unexpected token: " + std::string(tokens.text(peek())), tokens.location(peek()));
 }
 
-std::unique_ptr<Statement> Parser::parseIfStatement() {
+template <typename Builder>
+void BasicParser<Builder>::openIf() {
     // Parse condition
     if (!match(TokenType::LEFT_PAREN)) {
-        throw ParserError("Expected '(' after 'if'", peek().line, peek().column);
+        throw ParserError("Expected '(' after 'if'", tokens.location(peek()));
     }
     auto condition = parseExpression();
     if (!match(TokenType::RIGHT_PAREN)) {
-        throw ParserError("Expected ')' after if condition", peek().line, peek().column);
+        throw ParserError("Expected ')' after if condition", tokens.location(peek()));
     }
     // Parse then block
     if (!match(TokenType::LEFT_BRACE)) {
-        throw ParserError("Expected '{' before if body", peek().line, peek().column);
-    }
-    std::vector<std::unique_ptr<Statement>> thenStatements;
-    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
-        thenStatements.push_back(parseStatement());
+        throw ParserError("Expected '{' before if body", tokens.location(peek()));
     }
+    openIfs.push_back({condition, Builder::noBlock, pending.size(), false});
+}
+
+template <typename Builder>
+void BasicParser<Builder>::closeBlock() {
+    OpenIf& open = openIfs.back();
     if (!match(TokenType::RIGHT_BRACE)) {
-        throw ParserError("Expected '}' after if body", peek().line, peek().column);
+        throw ParserError(std::string("Expected '}' after ") + (open.inElse ? "else" : "if") + " body", tokens.location(peek()));
     }
-    auto thenBlock = std::make_unique<Block>(std::move(thenStatements));
-    // Parse else block if present
-    std::unique_ptr<Block> elseBlock = nullptr;
-    if (match(TokenType::ELSE)) {
-        if (!match(TokenType::LEFT_BRACE)) {
-            throw ParserError("Expected '{' before else body", peek().line, peek().column);
-        }
-        std::vector<std::unique_ptr<Statement>> elseStatements;
-        while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
-            elseStatements.push_back(parseStatement());
-        }
-        if (!match(TokenType::RIGHT_BRACE)) {
-            throw ParserError("Expected '}' after else body", peek().line, peek().column);
+    BlockRef block = builder.block(pending.data() + open.mark, pending.size() - open.mark);
+    pending.resize(open.mark);
+    if (!open.inElse) {
+        open.thenBlock = block;
+        // Parse else block if present
+        if (match(TokenType::ELSE)) {
+            if (!match(TokenType::LEFT_BRACE)) {
+                throw ParserError("Expected '{' before else body", tokens.location(peek()));
+            }
+            open.inElse = true;
+            return;
         }
-        elseBlock = std::make_unique<Block>(std::move(elseStatements));
+        block = Builder::noBlock;
     }
-    return std::make_unique<IfStatement>(std::move(condition), std::move(thenBlock), std::move(elseBlock));
+    StatementRef statement = builder.ifStatement(open.condition, open.thenBlock, block);
+    openIfs.pop_back();
+    pending.push_back(statement);
 }
 
-std::unique_ptr<Statement> Parser::parseVariableDeclaration() {
+template <typename Builder>
+typename BasicParser<Builder>::StatementRef BasicParser<Builder>::parseVariableDeclaration() {
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name");
     consume(TokenType::EQUALS, "Expected '=' after variable name");
     auto value = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration");
-    return std::make_unique<VariableDeclaration>(name.value, std::move(value));
+    return builder.variableDeclaration(name.symbol, value);
 }
 
-std::unique_ptr<Statement> Parser::parseShowStatement() {
+template <typename Builder>
+typename BasicParser<Builder>::StatementRef BasicParser<Builder>::parseShowStatement() {
     auto expr = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after show statement");
-    return std::make_unique<ShowStatement>(std::move(expr));
+    return builder.show(expr);
 }
 
-std::unique_ptr<Statement> Parser::parseAssignmentStatement() {
+template <typename Builder>
+typename BasicParser<Builder>::StatementRef BasicParser<Builder>::parseAssignmentStatement() {
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name");
     consume(TokenType::EQUALS, "Expected '=' in assignment");
     auto value = parseExpression();
     consume(TokenType::SEMICOLON, "Expected ';' after assignment");
-    return std::make_unique<AssignmentStatement>(name.value, std::move(value));
+    return builder.assignment(name.symbol, value);
 }
 
-std::unique_ptr<Expression> Parser::parseExpression() {
-    return parseComparison();
-}
+// Binary operators by token type. Precedence 0 means the token does not
+// continue an expression; higher binds tighter. Adding an operator is one
+// row here plus its BinaryOperator in the code generator.
+struct BinaryOperatorInfo {
+    unsigned precedence;
+    bool rightAssociative;
+    BinaryOperator op;
+};
 
-std::unique_ptr<Expression> Parser::parseComparison() {
-    auto expr = parseTerm();
-    
-    while (match(TokenType::GREATER_THAN) || match(TokenType::LESS_THAN) ||
-           match(TokenType::GREATER_EQUAL) || match(TokenType::LESS_EQUAL) ||
-           match(TokenType::EQUAL_EQUAL) || match(TokenType::NOT_EQUAL)) {
-        BinaryOperator op;
-        switch (previous().type) {
-            case TokenType::GREATER_THAN: op = BinaryOperator::GREATER_THAN; break;
-            case TokenType::LESS_THAN: op = BinaryOperator::LESS_THAN; break;
-            case TokenType::GREATER_EQUAL: op = BinaryOperator::GREATER_EQUAL; break;
-            case TokenType::LESS_EQUAL: op = BinaryOperator::LESS_EQUAL; break;
-            case TokenType::EQUAL_EQUAL: op = BinaryOperator::EQUAL_EQUAL; break;
-            case TokenType::NOT_EQUAL: op = BinaryOperator::NOT_EQUAL; break;
-            default: throw ParserError("Invalid comparison operator", previous().line, previous().column);
-        }
-        
-        auto right = parseTerm();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
-    }
-    
-    return expr;
-}
+static constexpr size_t tokenTypeCount = static_cast<size_t>(TokenType::ERROR) + 1;
 
-std::unique_ptr<Expression> Parser::parseTerm() {
-    auto expr = parseFactor();
-    
-    while (match(TokenType::PLUS) || match(TokenType::MINUS)) {
-        BinaryOperator op = previous().type == TokenType::PLUS ? BinaryOperator::ADD : BinaryOperator::SUBTRACT;
-        auto right = parseFactor();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+static constexpr std::array<BinaryOperatorInfo, tokenTypeCount> buildOperatorTable() {
+    std::array<BinaryOperatorInfo, tokenTypeCount> table{};
+    const std::pair<TokenType, BinaryOperatorInfo> rows[] = {
+        {TokenType::PIPE, {1, false, BinaryOperator::BITWISE_OR}},
+        {TokenType::CARET, {2, false, BinaryOperator::BITWISE_XOR}},
+        {TokenType::AMPERSAND, {3, false, BinaryOperator::BITWISE_AND}},
+        {TokenType::GREATER_THAN, {4, false, BinaryOperator::GREATER_THAN}},
+        {TokenType::LESS_THAN, {4, false, BinaryOperator::LESS_THAN}},
+        {TokenType::GREATER_EQUAL, {4, false, BinaryOperator::GREATER_EQUAL}},
+        {TokenType::LESS_EQUAL, {4, false, BinaryOperator::LESS_EQUAL}},
+        {TokenType::EQUAL_EQUAL, {4, false, BinaryOperator::EQUAL_EQUAL}},
+        {TokenType::NOT_EQUAL, {4, false, BinaryOperator::NOT_EQUAL}},
+        {TokenType::PLUS, {5, false, BinaryOperator::ADD}},
+        {TokenType::MINUS, {5, false, BinaryOperator::SUBTRACT}},
+        {TokenType::MULTIPLY, {6, false, BinaryOperator::MULTIPLY}},
+        {TokenType::DIVIDE, {6, false, BinaryOperator::DIVIDE}},
+        {TokenType::PERCENT, {6, false, BinaryOperator::MODULO}}
+    };
+    for (const auto& row : rows) {
+        table[static_cast<size_t>(row.first)] = row.second;
     }
-    
-    return expr;
+    return table;
 }
 
-std::unique_ptr<Expression> Parser::parseFactor() {
-    auto expr = parsePrimary();
-    
-    while (match(TokenType::MULTIPLY) || match(TokenType::DIVIDE)) {
-        BinaryOperator op = previous().type == TokenType::MULTIPLY ? BinaryOperator::MULTIPLY : BinaryOperator::DIVIDE;
-        auto right = parsePrimary();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
+static constexpr std::array<BinaryOperatorInfo, tokenTypeCount> operatorTable = buildOperatorTable();
+
+// Prefix operators bind tighter than any binary operator: -a * b is (-a) * b
+static constexpr unsigned unaryPrecedence = 7;
+
+// Operator precedence parsing on explicit stacks: operands and pending
+// operators (and open parentheses) are pushed as they are read, and an
+// operator is applied once the next operator's table entry shows it binds at
+// least as tightly. One table lookup per token decides whether the
+// expression continues, and nesting never recurses. Nodes come out in
+// post-order, as the flat AST needs.
+template <typename Builder>
+typename BasicParser<Builder>::ExpressionRef BasicParser<Builder>::parseExpression() {
+    using Kind = typename PendingOperator::Kind;
+    operands.clear(); // expressions do not nest inside each other
+    operators.clear();
+    size_t openParens = 0;
+    while (true) {
+        // an operand, after any prefix operators and '('
+        while (true) {
+            if (match(TokenType::MINUS)) {
+                operators.push_back({Kind::Unary, unaryPrecedence, BinaryOperator::ADD, UnaryOperator::NEGATE});
+            } else if (match(TokenType::BANG)) {
+                operators.push_back({Kind::Unary, unaryPrecedence, BinaryOperator::ADD, UnaryOperator::NOT});
+            } else if (match(TokenType::LEFT_PAREN)) {
+                operators.push_back({Kind::Paren, 0, BinaryOperator::ADD, UnaryOperator::NEGATE});
+                openParens++;
+            } else {
+                break;
+            }
+        }
+        operands.push_back(parsePrimary());
+
+        // then any ')', and a binary operator or the end of the expression
+        while (true) {
+            const BinaryOperatorInfo& info = operatorTable[static_cast<size_t>(peek().type)];
+            if (info.precedence > 0) { // 0 for tokens that are not operators
+                reduceOperators(info.rightAssociative ? info.precedence + 1 : info.precedence);
+                advance();
+                operators.push_back({Kind::Binary, info.precedence, info.op, UnaryOperator::NEGATE});
+                break;
+            }
+            if (openParens > 0) {
+                consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
+                reduceOperators(1);
+                operators.pop_back(); // the '('
+                openParens--;
+                continue;
+            }
+            reduceOperators(1);
+            return operands.back();
+        }
     }
-    
-    return expr;
 }
 
-std::unique_ptr<Expression> Parser::parsePrimary() {
-    if (match(TokenType::STRING_LITERAL)) {
-        return std::make_unique<StringLiteral>(previous().value);
-    }
-    
-    if (match(TokenType::NUMBER_LITERAL)) {
-        return std::make_unique<NumberLiteral>(std::stoi(previous().value));
-    }
-    
-    if (match(TokenType::IDENTIFIER)) {
-        return std::make_unique<Identifier>(previous().value);
+template <typename Builder>
+void BasicParser<Builder>::reduceOperators(unsigned minPrecedence) {
+    while (!operators.empty() && operators.back().kind != PendingOperator::Kind::Paren &&
+           operators.back().precedence >= minPrecedence) {
+        PendingOperator pendingOperator = operators.back();
+        operators.pop_back();
+        if (pendingOperator.kind == PendingOperator::Kind::Unary) {
+            operands.back() = builder.unary(pendingOperator.unary, operands.back());
+        } else {
+            ExpressionRef right = operands.back();
+            operands.pop_back();
+            operands.back() = builder.binary(operands.back(), pendingOperator.binary, right);
+        }
     }
+}
 
-    // Add support for parenthesized expressions
-    if (match(TokenType::LEFT_PAREN)) {
-        auto expr = parseExpression();
-        consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
-        return expr;
+template <typename Builder>
+typename BasicParser<Builder>::ExpressionRef BasicParser<Builder>::parsePrimary() {
+    switch (peek().type) {
+        case TokenType::STRING_LITERAL:
+            return builder.stringLiteral(tokens.text(advance()));
+        case TokenType::NUMBER_LITERAL:
+            return builder.integerLiteral(advance().integer);
+        case TokenType::FLOAT_LITERAL:
+            return builder.floatLiteral(advance().real);
+        case TokenType::IDENTIFIER:
+            return builder.identifier(advance().symbol);
+        default:
+            break;
     }
     
-    throw ParserError("Unexpected token in expression: " + peek().value, peek().line, peek().column);
+    throw ParserError("Unexpected token in expression: " + std::string(tokens.text(peek())), tokens.location(peek()));
 }
 
-bool Parser::match(TokenType type) {
+template <typename Builder>
+bool BasicParser<Builder>::match(TokenType type) {
     if (check(type)) {
         advance();
         return true;
@@ -183,34 +277,42 @@ bool Parser::match(TokenType type) {
     return false;
 }
 
-bool Parser::check(TokenType type) {
+template <typename Builder>
+bool BasicParser<Builder>::check(TokenType type) {
     if (isAtEnd()) return false;
     return peek().type == type;
 }
 
-Token Parser::advance() {
-    if (!isAtEnd()) current++;
-    return previous();
+template <typename Builder>
+const Token& BasicParser<Builder>::advance() {
+    return tokens.advance();
 }
 
-bool Parser::isAtEnd() {
+template <typename Builder>
+bool BasicParser<Builder>::isAtEnd() {
     return peek().type == TokenType::EOF_TOKEN;
 }
 
-Token Parser::peek() {
-    return tokens[current];
+template <typename Builder>
+const Token& BasicParser<Builder>::peek() {
+    return tokens.peek();
 }
 
-Token Parser::previous() {
-    return tokens[current - 1];
+template <typename Builder>
+const Token& BasicParser<Builder>::previous() {
+    return tokens.previous();
 }
 
 //consume token
-Token Parser::consume(TokenType type, const std::string& message) {
+template <typename Builder>
+Token BasicParser<Builder>::consume(TokenType type, const std::string& message) {
     if (check(type)) {
         Token token = advance();
-        std::cout << "[Parser] Consumed token: " << token.value << " (Type: " << static_cast<int>(token.type) << ")" << std::endl;
+        GEHU_TRACE(Parser, Debug, "Consumed token: " << tokens.text(token) << " (Type: " << static_cast<int>(token.type) << ")");
         return token;
     }
-    throw ParserError(message, peek().line, peek().column);
+    throw ParserError(message, tokens.location(peek()));
 }
+
+template class BasicParser<TreeBuilder>;
+template class BasicParser<FlatBuilder>;
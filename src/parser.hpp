@@ -1,4 +1,3 @@
-// 
 //Parser class definition
 //Parser class is responsible for parsing the source code
 //It reads the tokens and creates an AST
@@ -8,38 +7,143 @@
 //It also handles operators, delimiters, and special characters
 //It also handles keywords
 //It also handles errors
+//The grammar is written once against a Builder, which decides what a node
+//is: TreeBuilder creates ASTContext nodes (Parser), FlatBuilder appends
+//slots to a FlatAST (FlatParser)
+//Nested if blocks and parentheses are tracked on explicit stacks rather
+//than by recursion, so nesting depth is limited only by memory
 #pragma once
 
-#include "lexer.hpp"
+#include "token_stream.hpp"
 #include "ast.hpp"
+#include "flat_ast.hpp"
 #include <vector>
-#include <memory>
 
-class Parser {
+// Builds the pointer tree; node references are pointers into the context
+class TreeBuilder {
 public:
-    explicit Parser(const std::vector<Token>& tokens);
-    std::unique_ptr<Program> parse();
+    using ExpressionRef = Expression*;
+    using StatementRef = Statement*;
+    using BlockRef = Block*;
+    using ProgramRef = Program*;
+    static constexpr Block* noBlock = nullptr;
+
+    explicit TreeBuilder(ASTContext& context) : context(context) {}
+
+    Expression* stringLiteral(std::string_view text) { return context.create<StringLiteral>(context.copyString(text)); }
+    Expression* integerLiteral(int64_t value) { return context.create<NumberLiteral>(value); }
+    Expression* floatLiteral(double value) { return context.create<NumberLiteral>(value); }
+    Expression* identifier(Symbol name) { return context.create<Identifier>(name); }
+    Expression* binary(Expression* left, BinaryOperator op, Expression* right) {
+        return context.create<BinaryExpression>(left, op, right);
+    }
+    Expression* unary(UnaryOperator op, Expression* operand) { return context.create<UnaryExpression>(op, operand); }
+    Statement* variableDeclaration(Symbol name, Expression* value) { return context.create<VariableDeclaration>(name, value); }
+    Statement* show(Expression* expression) { return context.create<ShowStatement>(expression); }
+    Statement* assignment(Symbol name, Expression* value) { return context.create<AssignmentStatement>(name, value); }
+    Statement* ifStatement(Expression* condition, Block* thenBlock, Block* elseBlock) {
+        return context.create<IfStatement>(condition, thenBlock, elseBlock);
+    }
+    Block* block(Statement* const* statements, size_t count) {
+        return context.create<Block>(context.copyList(statements, count));
+    }
+    Program* program(Statement* const* statements, size_t count) {
+        return context.create<Program>(context.copyList(statements, count));
+    }
+
+private:
+    ASTContext& context;
+};
+
+// Builds a FlatAST; node references are slot indices
+class FlatBuilder {
+public:
+    using ExpressionRef = uint32_t;
+    using StatementRef = uint32_t;
+    using BlockRef = uint32_t;
+    using ProgramRef = uint32_t;
+    static constexpr uint32_t noBlock = FlatAST::none;
+
+    explicit FlatBuilder(FlatAST& ast) : ast(ast) {}
+
+    uint32_t stringLiteral(std::string_view text);
+    uint32_t integerLiteral(int64_t value) { return ast.add(FlatKind::IntegerLiteral, 0, 0, static_cast<uint64_t>(value)); }
+    uint32_t floatLiteral(double value);
+    uint32_t identifier(Symbol name) { return ast.add(FlatKind::Identifier, 0, 0, name); }
+    uint32_t binary(uint32_t left, BinaryOperator op, uint32_t right) {
+        return ast.add(FlatKind::Binary, left, right, ast.expressionStart(left), op);
+    }
+    uint32_t unary(UnaryOperator op, uint32_t operand) {
+        return ast.add(FlatKind::Unary, operand, static_cast<uint32_t>(op), ast.expressionStart(operand));
+    }
+    uint32_t variableDeclaration(Symbol name, uint32_t value) { return ast.add(FlatKind::VariableDeclaration, value, 0, name); }
+    uint32_t show(uint32_t expression) { return ast.add(FlatKind::Show, expression, 0, 0); }
+    uint32_t assignment(Symbol name, uint32_t value) { return ast.add(FlatKind::Assignment, value, 0, name); }
+    uint32_t ifStatement(uint32_t condition, uint32_t thenBlock, uint32_t elseBlock) {
+        return ast.add(FlatKind::If, condition, thenBlock, elseBlock);
+    }
+    uint32_t block(const uint32_t* statements, size_t count);
+    uint32_t program(const uint32_t* statements, size_t count) { return ast.root = block(statements, count); }
 
 private:
-    std::vector<Token> tokens;
-    size_t current;
-
-    std::unique_ptr<Statement> parseStatement();
-    std::unique_ptr<Statement> parseVariableDeclaration();
-    std::unique_ptr<Statement> parseShowStatement();
-    std::unique_ptr<Statement> parseIfStatement();
-    std::unique_ptr<Statement> parseAssignmentStatement();
-    std::unique_ptr<Expression> parseExpression();
-    std::unique_ptr<Expression> parseComparison();
-    std::unique_ptr<Expression> parseTerm();
-    std::unique_ptr<Expression> parseFactor();
-    std::unique_ptr<Expression> parsePrimary();
+    FlatAST& ast;
+};
+
+template <typename Builder>
+class BasicParser {
+public:
+    using ExpressionRef = typename Builder::ExpressionRef;
+    using StatementRef = typename Builder::StatementRef;
+    using BlockRef = typename Builder::BlockRef;
+
+    // both borrowed; nodes are owned by whatever the builder writes into
+    BasicParser(TokenStream& tokens, Builder& builder);
+    typename Builder::ProgramRef parse();
+
+private:
+    TokenStream& tokens;
+    Builder& builder;
+    std::vector<StatementRef> pending; // statements of the blocks being parsed, innermost last
+
+    // an if whose then or else block is being parsed
+    struct OpenIf {
+        ExpressionRef condition;
+        BlockRef thenBlock; // once the then block is closed
+        size_t mark; // where the current block's statements start in pending
+        bool inElse;
+    };
+    std::vector<OpenIf> openIfs; // innermost last
+
+    // an operator waiting for its right operand, or an open '('
+    struct PendingOperator {
+        enum class Kind : uint8_t { Binary, Unary, Paren };
+        Kind kind;
+        unsigned precedence;
+        BinaryOperator binary;
+        UnaryOperator unary;
+    };
+    std::vector<ExpressionRef> operands; // of the expression being parsed
+    std::vector<PendingOperator> operators;
+
+    StatementRef parseStatement(); // any statement but if
+    StatementRef parseVariableDeclaration();
+    StatementRef parseShowStatement();
+    StatementRef parseAssignmentStatement();
+    void openIf(); // after 'if', through the '{' of its then block
+    void closeBlock(); // at the '}' of the innermost open if's current block
+    ExpressionRef parseExpression();
+    void reduceOperators(unsigned minPrecedence); // apply stacked operators binding at least this tightly
+    ExpressionRef parsePrimary();
     
     bool match(TokenType type);
     bool check(TokenType type);
-    Token advance();
+    const Token& advance();
     bool isAtEnd();
-    Token peek();
-    Token previous();
+    const Token& peek();
+    const Token& previous();
     Token consume(TokenType type, const std::string& message);
 };
+
+// instantiated in parser.cpp
+using Parser = BasicParser<TreeBuilder>;
+using FlatParser = BasicParser<FlatBuilder>;
@@ -0,0 +1,97 @@
+#include "pipelined_lexer.hpp"
+#include "trace.hpp"
+#include <algorithm> // for copy_n
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // for _mm_pause
+#endif
+
+PipelinedLexer::PipelinedLexer(std::string_view source, StringInterner& symbols)
+    : lexer(source, symbols), cancelled(false), current(nullptr), currentIndex(0), finished(false),
+      thread(&PipelinedLexer::produce, this) {}
+
+PipelinedLexer::~PipelinedLexer() {
+    cancelled.store(true, std::memory_order_relaxed);
+    thread.join();
+}
+
+// spin briefly, since the other side usually catches up within a batch,
+// then yield the core
+void PipelinedLexer::pause(unsigned& spins) {
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+void PipelinedLexer::produce() {
+    GEHU_TRACE(Lexer, Info, "Lexer thread started");
+    bool done = false;
+    while (!done) {
+        Batch* batch;
+        unsigned spins = 0;
+        while (!(batch = queue.producerSlot())) {
+            if (cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            pause(spins);
+        }
+
+        batch->tokens.resize(batchSize);
+        batch->error = nullptr;
+        size_t count = 0;
+        try {
+            while (count < batchSize && !done) {
+                batch->tokens[count] = lexer.nextToken();
+                done = batch->tokens[count].type == TokenType::EOF_TOKEN;
+                count++;
+            }
+        } catch (...) {
+            batch->error = std::current_exception();
+            done = true;
+        }
+        batch->tokens.resize(count);
+        queue.push();
+    }
+    GEHU_TRACE(Lexer, Info, "Lexer thread finished");
+}
+
+size_t PipelinedLexer::fill(Token* out, size_t max) {
+    size_t count = 0;
+    while (count < max && !finished) {
+        if (!current) {
+            unsigned spins = 0;
+            while (!(current = queue.consumerSlot())) {
+                pause(spins);
+            }
+            currentIndex = 0;
+        }
+
+        size_t available = std::min(max - count, current->tokens.size() - currentIndex);
+        std::copy_n(current->tokens.data() + currentIndex, available, out + count);
+        currentIndex += available;
+        count += available;
+        if (currentIndex < current->tokens.size()) {
+            break; // out is full
+        }
+
+        if (current->error) {
+            // deliver the tokens before the error first, so a parser error
+            // earlier in the source still wins
+            if (count > 0) {
+                break;
+            }
+            std::exception_ptr error = current->error;
+            current->error = nullptr;
+            finished = true;
+            std::rethrow_exception(error);
+        }
+        finished = !current->tokens.empty() && current->tokens.back().type == TokenType::EOF_TOKEN;
+        current = nullptr;
+        queue.pop();
+    }
+    return count;
+}
@@ -0,0 +1,45 @@
+//PipelinedLexer class definition
+//PipelinedLexer runs the lexer on its own thread and hands tokens to the
+//parser in batches through a lock-free SPSC queue, so lexing and parsing
+//overlap (--pipeline). A lexer error travels through the queue behind the
+//tokens before it, so errors still surface in source order.
+#pragma once
+
+#include "lexer.hpp"
+#include "spsc_queue.hpp"
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+class PipelinedLexer : public TokenProducer {
+public:
+    // source and symbols are used by the lexer thread until EOF; symbols must
+    // not be touched by anyone else before that (or before destruction)
+    PipelinedLexer(std::string_view source, StringInterner& symbols);
+    ~PipelinedLexer() override; // stops the lexer thread if the parser gave up early
+    PipelinedLexer(const PipelinedLexer&) = delete;
+    PipelinedLexer& operator=(const PipelinedLexer&) = delete;
+
+    size_t fill(Token* out, size_t max) override;
+
+private:
+    struct Batch {
+        std::vector<Token> tokens;
+        std::exception_ptr error; // thrown after the batch's tokens are consumed
+    };
+
+    static constexpr size_t batchSize = 4096;
+    static constexpr size_t queueDepth = 8;
+
+    void produce(); // lexer thread body
+    void pause(unsigned& spins); // wait for the other thread
+
+    Lexer lexer;
+    SpscQueue<Batch, queueDepth> queue;
+    std::atomic<bool> cancelled;
+    Batch* current; // batch being consumed, null between batches
+    size_t currentIndex;
+    bool finished; // the EOF token has been consumed
+    std::thread thread; // last, so it starts once everything else is ready
+};
@@ -0,0 +1,136 @@
+#include "profiler.hpp"
+#include <llvm/Support/TimeProfiler.h> // phases as --time-trace spans
+#include <sys/resource.h> // for getrusage
+#include <atomic> // for the allocation counters
+#include <chrono>
+#include <cstdlib> // for malloc and free
+#include <ctime> // for clock_gettime
+#include <iomanip>
+#include <new>
+#include <sstream> // for printTable
+
+// Process-wide allocation counters behind the replaced global operator new.
+// Relaxed increments keep the cost negligible when no report is requested.
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<uint64_t> allocationBytes{0};
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+static double wallNowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double cpuNowMs() {
+    timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+static long peakRssKb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+}
+
+PhaseProfiler::Scope::Scope(PhaseProfiler* profiler, const char* name)
+    : profiler(profiler), name(name), traced(llvm::getTimeTraceProfilerInstance() != nullptr) {
+    if (traced) {
+        llvm::timeTraceProfilerBegin(name, llvm::StringRef());
+    }
+    if (!profiler) {
+        return;
+    }
+    wallStart = wallNowMs();
+    cpuStart = cpuNowMs();
+    peakRssStart = peakRssKb();
+    allocationsStart = allocationCount.load(std::memory_order_relaxed);
+    bytesStart = allocationBytes.load(std::memory_order_relaxed);
+}
+
+PhaseProfiler::Scope::~Scope() {
+    if (traced) {
+        llvm::timeTraceProfilerEnd();
+    }
+    if (!profiler) {
+        return;
+    }
+    Phase phase;
+    phase.name = name;
+    phase.wallMs = wallNowMs() - wallStart;
+    phase.cpuMs = cpuNowMs() - cpuStart;
+    phase.peakRssDeltaKb = peakRssKb() - peakRssStart;
+    phase.allocations = allocationCount.load(std::memory_order_relaxed) - allocationsStart;
+    phase.allocatedBytes = allocationBytes.load(std::memory_order_relaxed) - bytesStart;
+    profiler->phases.push_back(phase);
+}
+
+void PhaseProfiler::setCounter(const std::string& name, uint64_t value) {
+    for (auto& counter : counters) {
+        if (counter.first == name) {
+            counter.second = value;
+            return;
+        }
+    }
+    counters.emplace_back(name, value);
+}
+
+// built in a local stream so the caller's stream keeps its own formatting
+void PhaseProfiler::printTable(std::ostream& out) const {
+    std::ostringstream table;
+    Phase total = {"total", 0, 0, 0, 0, 0};
+    table << std::left << std::setw(16) << "phase" << std::right
+        << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << std::setw(14) << "peak rss +kb"
+        << std::setw(10) << "allocs" << std::setw(14) << "alloc bytes" << "\n";
+    auto printRow = [&table](const Phase& phase) {
+        table << std::left << std::setw(16) << phase.name << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << phase.wallMs << std::setw(12) << phase.cpuMs << std::setw(14) << phase.peakRssDeltaKb
+            << std::setw(10) << phase.allocations << std::setw(14) << phase.allocatedBytes << "\n";
+    };
+    for (const Phase& phase : phases) {
+        printRow(phase);
+        total.wallMs += phase.wallMs;
+        total.cpuMs += phase.cpuMs;
+        total.peakRssDeltaKb += phase.peakRssDeltaKb;
+        total.allocations += phase.allocations;
+        total.allocatedBytes += phase.allocatedBytes;
+    }
+    printRow(total);
+    for (const auto& counter : counters) {
+        table << std::left << std::setw(16) << counter.first << std::right << std::setw(12) << counter.second << "\n";
+    }
+    out << table.str();
+}
+
+// names are compiler-chosen identifiers, so no JSON string escaping is needed
+void PhaseProfiler::printJSON(std::ostream& out) const {
+    out << "{\"phases\":[";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase& phase = phases[i];
+        out << (i ? "," : "") << "{\"name\":\"" << phase.name << "\""
+            << ",\"wall_ms\":" << phase.wallMs
+            << ",\"cpu_ms\":" << phase.cpuMs
+            << ",\"peak_rss_delta_kb\":" << phase.peakRssDeltaKb
+            << ",\"allocations\":" << phase.allocations
+            << ",\"allocated_bytes\":" << phase.allocatedBytes << "}";
+    }
+    out << "],\"counters\":{";
+    for (size_t i = 0; i < counters.size(); i++) {
+        out << (i ? "," : "") << "\"" << counters[i].first << "\":" << counters[i].second;
+    }
+    out << "}}\n";
+}
@@ -0,0 +1,54 @@
+//PhaseProfiler class definition
+//PhaseProfiler records wall time, CPU time, peak RSS growth and heap
+//allocations for each compiler phase, plus counters such as tokens and AST
+//nodes, and prints them as a table or as JSON (--time-report)
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class PhaseProfiler {
+public:
+    struct Phase {
+        std::string name;
+        double wallMs;
+        double cpuMs;
+        long peakRssDeltaKb; // how far the phase raised the process high-water mark
+        uint64_t allocations;
+        uint64_t allocatedBytes;
+    };
+
+    // measures one phase from construction to destruction; a null profiler
+    // measures nothing, so call sites need no checks of their own. The phase
+    // is also a span in the --time-trace timeline when that is enabled.
+    class Scope {
+    public:
+        Scope(PhaseProfiler* profiler, const char* name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        PhaseProfiler* profiler;
+        const char* name;
+        bool traced;
+        double wallStart;
+        double cpuStart;
+        long peakRssStart;
+        uint64_t allocationsStart;
+        uint64_t bytesStart;
+    };
+
+    void setCounter(const std::string& name, uint64_t value);
+    const std::vector<Phase>& getPhases() const { return phases; }
+
+    void printTable(std::ostream& out) const;
+    void printJSON(std::ostream& out) const;
+
+private:
+    std::vector<Phase> phases;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+};
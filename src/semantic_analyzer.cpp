@@ -1,10 +1,123 @@
 #include "ast.hpp"
 #include "semantic_analyzer.hpp"
 #include "errors.hpp"
+#include "trace.hpp"
+
+SemanticAnalyzer::SemanticAnalyzer(const StringInterner& symbols) : symbols(symbols) {}
 
 void SemanticAnalyzer::analyze(Program* program) {
-    for (const auto& statement : program->statements) {
-        statement->accept(*this);
+    declared.assign(symbols.size(), 0);
+    scopeLog.clear();
+    openBlocks.clear();
+    expressionWork.clear();
+    GEHU_TRACE(Sema, Info, "Analyzing " << program->statements.size() << " top-level statements");
+    openBlocks.push_back({program->statements.begin(), program->statements.end(), 0});
+    analyzeOpenBlocks();
+}
+
+void SemanticAnalyzer::analyze(const FlatAST& ast) {
+    declared.assign(symbols.size(), 0);
+    scopeLog.clear();
+    openFlatBlocks.clear();
+    GEHU_TRACE(Sema, Info, "Analyzing " << ast.rhs[ast.root] << " top-level statements (flat)");
+    openFlatBlock(ast, ast.root);
+    analyzeOpenFlatBlocks(ast);
+}
+
+// Statements of the innermost open block are visited in order; an if opens
+// its blocks on top, so they finish before the statement after the if
+void SemanticAnalyzer::analyzeOpenBlocks() {
+    while (!openBlocks.empty()) {
+        OpenBlock<Statement*>& block = openBlocks.back();
+        if (block.next == block.end) {
+            endScope(block.scopeStart);
+            openBlocks.pop_back();
+        } else {
+            visit(*block.next++); // may push, so block is not used after this
+        }
+    }
+}
+
+void SemanticAnalyzer::analyzeOpenFlatBlocks(const FlatAST& ast) {
+    while (!openFlatBlocks.empty()) {
+        OpenBlock<uint32_t>& block = openFlatBlocks.back();
+        if (block.next == block.end) {
+            endScope(block.scopeStart);
+            openFlatBlocks.pop_back();
+        } else {
+            analyzeFlatStatement(ast, *block.next++);
+        }
+    }
+}
+
+// Restore the old scope
+void SemanticAnalyzer::endScope(size_t scopeStart) {
+    while (scopeLog.size() > scopeStart) {
+        declared[scopeLog.back()] = 0;
+        scopeLog.pop_back();
+    }
+}
+
+// Mirrors visitBlock: declarations made inside are undone at the end
+void SemanticAnalyzer::openFlatBlock(const FlatAST& ast, uint32_t block) {
+    openFlatBlocks.push_back({ast.statementsBegin(block), ast.statementsEnd(block), scopeLog.size()});
+}
+
+void SemanticAnalyzer::analyzeFlatStatement(const FlatAST& ast, uint32_t statement) {
+    switch (ast.kinds[statement]) {
+        case FlatKind::VariableDeclaration: {
+            Symbol name = ast.symbol(statement);
+            if (declared[name]) {
+                throw SemanticError("Variable already declared: " + std::string(symbols.spelling(name)), 0, 0);
+            }
+            checkFlatExpression(ast, ast.lhs[statement]);
+            declared[name] = 1;
+            scopeLog.push_back(name);
+            GEHU_TRACE(Sema, Debug, "Declared variable: " << symbols.spelling(name));
+            break;
+        }
+        case FlatKind::Assignment: {
+            Symbol name = ast.symbol(statement);
+            if (!declared[name]) {
+                throw SemanticError("Assignment to undeclared variable: " + std::string(symbols.spelling(name)), 0, 0);
+            }
+            checkFlatExpression(ast, ast.lhs[statement]);
+            break;
+        }
+        case FlatKind::Show:
+            checkFlatExpression(ast, ast.lhs[statement]);
+            break;
+        case FlatKind::If:
+            checkFlatExpression(ast, ast.lhs[statement]);
+            // the then block runs first, so it is opened last
+            if (ast.payloads[statement] != FlatAST::none) {
+                openFlatBlock(ast, static_cast<uint32_t>(ast.payloads[statement]));
+            }
+            openFlatBlock(ast, ast.rhs[statement]);
+            break;
+        default:
+            throw SemanticError("Unexpected node in statement list", 0, 0);
+    }
+}
+
+// An expression is a contiguous post-order run of slots, so its identifiers
+// are checked left to right by scanning the run, with no recursion
+void SemanticAnalyzer::checkFlatExpression(const FlatAST& ast, uint32_t expression) {
+    for (uint32_t node = ast.expressionStart(expression); node <= expression; node++) {
+        if (ast.kinds[node] == FlatKind::Identifier && !declared[ast.symbol(node)]) {
+            throw SemanticError("Undefined variable: " + std::string(symbols.spelling(ast.symbol(node))), 0, 0);
+        }
+    }
+}
+
+// Subexpressions are checked left to right: each visit pushes its operands
+// right first, so the left one comes off the stack next
+void SemanticAnalyzer::checkExpression(Expression* expression) {
+    expressionWork.push_back(expression);
+    while (!expressionWork.empty()) {
+        Expression* next = expressionWork.back();
+        expressionWork.pop_back();
+        visit(next);
     }
 }
 
@@ -17,14 +130,14 @@ void SemanticAnalyzer::visitNumberLiteral(NumberLiteral* node) {
 }
 
 void SemanticAnalyzer::visitIdentifier(Identifier* node) {
-    if (variables.find(node->name) == variables.end()) {
-        throw SemanticError("Undefined variable: " + node->name, 0, 0);
+    if (!declared[node->name]) {
+        throw SemanticError("Undefined variable: " + std::string(symbols.spelling(node->name)), 0, 0);
     }
 }
 
 void SemanticAnalyzer::visitBinaryExpression(BinaryExpression* node) {
-    node->left->accept(*this);
-    node->right->accept(*this);
+    expressionWork.push_back(node->right);
+    expressionWork.push_back(node->left);
     
     // Check for valid comparison operations
     switch (node->op) {
@@ -40,59 +153,63 @@ void SemanticAnalyzer::visitBinaryExpression(BinaryExpression* node) {
         case BinaryOperator::SUBTRACT:
         case BinaryOperator::MULTIPLY:
         case BinaryOperator::DIVIDE:
+        case BinaryOperator::MODULO:
             // Arithmetic operations are valid between numbers
             break;
+        case BinaryOperator::BITWISE_AND:
+        case BinaryOperator::BITWISE_OR:
+        case BinaryOperator::BITWISE_XOR:
+            // Bitwise operations need integers, which codegen checks
+            break;
     }
 }
 
+void SemanticAnalyzer::visitUnaryExpression(UnaryExpression* node) {
+    expressionWork.push_back(node->operand);
+}
+
 void SemanticAnalyzer::visitBlock(Block* node) {
-    // Create a new scope for the block
-    std::map<std::string, bool> oldVariables = variables;
-    
-    // Analyze statements in the block
-    for (const auto& statement : node->statements) {
-        statement->accept(*this);
-    }
-    
-    // Restore the old scope
-    variables = oldVariables;
+    // Create a new scope for the block; analyzeOpenBlocks visits its
+    // statements and restores the old scope after them
+    openBlocks.push_back({node->statements.begin(), node->statements.end(), scopeLog.size()});
 }
 
 void SemanticAnalyzer::visitIfStatement(IfStatement* node) {
     // Analyze the condition
-    node->condition->accept(*this);
-    
-    // Analyze the then block
-    node->thenBlock->accept(*this);
+    checkExpression(node->condition);
     
-    // Analyze the else block if present
+    // Analyze the then block, then the else block if present; the else
+    // block is opened first so that it runs second
     if (node->elseBlock) {
-        node->elseBlock->accept(*this);
+        visitBlock(node->elseBlock);
     }
+    visitBlock(node->thenBlock);
 }
 
 void SemanticAnalyzer::visitVariableDeclaration(VariableDeclaration* node) {
     // Check if variable is already declared
-    if (variables.find(node->name) != variables.end()) {
-        throw SemanticError("Variable already declared: " + node->name, 0, 0);
+    if (declared[node->name]) {
+        throw SemanticError("Variable already declared: " + std::string(symbols.spelling(node->name)), 0, 0);
     }
     
     // Analyze the initializer expression
-    node->value->accept(*this);
+    checkExpression(node->value);
     
     // Add variable to current scope
-    variables[node->name] = true; // Track declared variable
+    declared[node->name] = 1; // Track declared variable
+    scopeLog.push_back(node->name);
+    GEHU_TRACE(Sema, Debug, "Declared variable: " << symbols.spelling(node->name));
 }
 
 void SemanticAnalyzer::visitShowStatement(ShowStatement* node) {
-    node->expression->accept(*this);
+    checkExpression(node->expression);
 }
 
 void SemanticAnalyzer::visitAssignmentStatement(AssignmentStatement* node) {
     // Check if variable is declared
-    if (variables.find(node->name) == variables.end()) {
-        throw SemanticError("Assignment to undeclared variable: " + node->name, 0, 0);
+    if (!declared[node->name]) {
+        throw SemanticError("Assignment to undeclared variable: " + std::string(symbols.spelling(node->name)), 0, 0);
     }
     // Analyze the assigned value
-    node->value->accept(*this);
+    checkExpression(node->value);
 }
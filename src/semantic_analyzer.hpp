@@ -1,24 +1,52 @@
 #pragma once
 
 #include "ast_visitor.hpp"
-#include <map>//for symbol table
-#include <string>//for variable names
+#include "flat_ast.hpp"
+#include "string_interner.hpp"//for symbol names
+#include <cstdint>
+#include <vector>//for symbol table
 
-class SemanticAnalyzer : public ASTVisitor {
+class SemanticAnalyzer : public ASTVisitor<SemanticAnalyzer> {
 public:
+    explicit SemanticAnalyzer(const StringInterner& symbols);
     //entry point
     void analyze(Program* program);
+    void analyze(const FlatAST& ast); // same checks and diagnostics, over the flat form
     
-    void visitStringLiteral(StringLiteral* node) override;
-    void visitNumberLiteral(NumberLiteral* node) override;
-    void visitIdentifier(Identifier* node) override;
-    void visitBinaryExpression(BinaryExpression* node) override;
-    void visitBlock(Block* node) override;
-    void visitIfStatement(IfStatement* node) override;
-    void visitVariableDeclaration(VariableDeclaration* node) override;
-    void visitShowStatement(ShowStatement* node) override;
-    void visitAssignmentStatement(AssignmentStatement* node) override;
+    void visitStringLiteral(StringLiteral* node);
+    void visitNumberLiteral(NumberLiteral* node);
+    void visitIdentifier(Identifier* node);
+    void visitBinaryExpression(BinaryExpression* node);
+    void visitUnaryExpression(UnaryExpression* node);
+    void visitBlock(Block* node);
+    void visitIfStatement(IfStatement* node);
+    void visitVariableDeclaration(VariableDeclaration* node);
+    void visitShowStatement(ShowStatement* node);
+    void visitAssignmentStatement(AssignmentStatement* node);
 
 private:
-    std::map<std::string, bool> variables;
+    // A block still being analyzed: its statements not yet visited and the
+    // scopeLog size to restore once they are. Blocks are walked from these
+    // explicit stacks instead of recursing, so deep nesting cannot overflow
+    // the native stack
+    template <typename StatementRef>
+    struct OpenBlock {
+        const StatementRef* next;
+        const StatementRef* end;
+        size_t scopeStart;
+    };
+    void analyzeOpenBlocks(); // until every open block is done
+    void analyzeOpenFlatBlocks(const FlatAST& ast);
+    void endScope(size_t scopeStart);
+    void checkExpression(Expression* expression);
+    void openFlatBlock(const FlatAST& ast, uint32_t block);
+    void analyzeFlatStatement(const FlatAST& ast, uint32_t statement);
+    void checkFlatExpression(const FlatAST& ast, uint32_t expression);
+
+    const StringInterner& symbols;
+    std::vector<uint8_t> declared; // indexed by symbol
+    std::vector<Symbol> scopeLog; // declarations in order, undone when their block ends
+    std::vector<OpenBlock<Statement*>> openBlocks; // innermost last
+    std::vector<OpenBlock<uint32_t>> openFlatBlocks;
+    std::vector<Expression*> expressionWork; // subexpressions still to check, next last
 };
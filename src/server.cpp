@@ -0,0 +1,533 @@
+#include "server.hpp"
+#include "driver.hpp"
+#include "codegen.hpp"
+#include "errors.hpp"
+#include "trace.hpp"
+#include <llvm/IR/LLVMContext.h> // for the context pool
+#include <sys/socket.h> // for the Unix domain socket
+#include <sys/un.h>
+#include <sys/wait.h> // for RUN children
+#include <unistd.h>
+#include <atomic> // for the latency counters
+#include <chrono>
+#include <algorithm>
+#include <csignal> // for SIGPIPE
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Contexts are handed out per connection and reused by its requests. Types and
+// constants interned in a context live as long as the context does, so each one
+// is retired after a fixed number of requests to bound its growth.
+class ContextPool {
+public:
+    std::unique_ptr<llvm::LLVMContext> acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (contexts.empty()) {
+            return std::make_unique<llvm::LLVMContext>();
+        }
+        std::unique_ptr<llvm::LLVMContext> context = std::move(contexts.back());
+        contexts.pop_back();
+        return context;
+    }
+
+    void release(std::unique_ptr<llvm::LLVMContext> context, unsigned uses) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (uses < maxUses && contexts.size() < maxPooled) {
+            contexts.push_back(std::move(context));
+        }
+    }
+
+    static const unsigned maxUses = 64;
+
+private:
+    static const size_t maxPooled = 16;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<llvm::LLVMContext>> contexts;
+};
+
+// request latency counters, reported by STATS
+struct ServerStats {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> totalMicros{0};
+    std::atomic<uint64_t> maxMicros{0};
+
+    void record(uint64_t micros, bool failed) {
+        requests++;
+        if (failed) {
+            failures++;
+        }
+        totalMicros += micros;
+        uint64_t max = maxMicros;
+        while (micros > max && !maxMicros.compare_exchange_weak(max, micros)) {
+        }
+    }
+
+    std::string report() const {
+        uint64_t count = requests;
+        std::ostringstream out;
+        out << "requests " << count << "\n"
+            << "failures " << failures << "\n"
+            << "mean_latency_us " << (count ? totalMicros / count : 0) << "\n"
+            << "max_latency_us " << maxMicros << "\n";
+        return out.str();
+    }
+};
+
+// limits on what a client may send, so a garbled or hostile header cannot
+// make the server allocate without bound
+static const size_t maxHeaderLength = 256;
+static const size_t maxSourceLength = 256 * 1024 * 1024;
+
+static bool writeAll(int fd, std::string_view data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+static bool readExactly(int fd, std::string& data, size_t length) {
+    data.resize(length);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = read(fd, &data[done], length - done);
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// headers are short, so reading them a byte at a time is fine; a longer
+// line is not a header
+static bool readLine(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (line.size() < maxHeaderLength && read(fd, &c, 1) == 1) {
+        if (c == '\n') {
+            return true;
+        }
+        line.push_back(c);
+    }
+    return false;
+}
+
+static bool writeResponse(int fd, int status, const std::string& output, const std::string& diagnostics) {
+    std::ostringstream header;
+    header << status << " " << output.size() << " " << diagnostics.size() << "\n";
+    return writeAll(fd, header.str()) && writeAll(fd, output) && writeAll(fd, diagnostics);
+}
+
+static bool readResponse(int fd, int& status, std::string& output, std::string& diagnostics) {
+    std::string header;
+    if (!readLine(fd, header)) {
+        return false;
+    }
+    std::istringstream fields(header);
+    size_t outputLength = 0;
+    size_t diagnosticsLength = 0;
+    fields >> status >> outputLength >> diagnosticsLength;
+    return fields && readExactly(fd, output, outputLength) && readExactly(fd, diagnostics, diagnosticsLength);
+}
+
+static void compileRequest(std::string_view source, const CompileOptions& options, int& status, std::string& diagnostics) {
+    try {
+        compileSource(source, options);
+    } catch (const std::exception& e) {
+        diagnostics = std::string("Error: ") + e.what() + "\n";
+        status = 1;
+    }
+}
+
+// A RUN executes the client's program, and a fault in it (say SIGFPE from a
+// division by zero) must not take down the server and every other client,
+// so programs run in processes of their own. Forking from a pool thread
+// could leave the child holding a lock (the trace sink, LLVM's) that another
+// thread had at that moment, so the forks come from a runner process started
+// while the server is still single-threaded. For each RUN a pool thread
+// passes the runner one end of a fresh socket pair. The runner forks a
+// supervisor, which forks the program's process under an alarm, waits for
+// it and answers on the socket in the same format the client reads.
+static const unsigned runTimeoutSeconds = 60;
+
+// pass fd over a Unix socket; one byte of data carries the descriptor
+static bool sendDescriptor(int socket, int fd) {
+    char byte = 0;
+    iovec data = {&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    return sendmsg(socket, &message, 0) == 1;
+}
+
+// -1 once the other end is closed
+static int receiveDescriptor(int socket) {
+    char byte;
+    iovec data = {&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr message = {};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t n;
+    while ((n = recvmsg(socket, &message, 0)) < 0 && errno == EINTR) {
+    }
+    cmsghdr* header = n == 1 ? CMSG_FIRSTHDR(&message) : nullptr;
+    if (!header || header->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int fd;
+    std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+    return fd;
+}
+
+static void readToEnd(int fd, std::string& data) {
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR)) {
+        if (n > 0) {
+            data.append(buffer, n);
+        }
+    }
+}
+
+// the program's process: read "<optLevel> <sourceLength>\n<source>" from fd,
+// compile and run it, and write the response to responseFd
+[[noreturn]] static void runProgram(int fd, int responseFd) {
+    alarm(runTimeoutSeconds); // SIGALRM ends a program that runs too long
+    std::string header;
+    std::string source;
+    std::string output;
+    std::string diagnostics;
+    int status = 0;
+    unsigned optLevel = 0;
+    size_t length = 0;
+    bool received = readLine(fd, header);
+    std::istringstream fields(header);
+    fields >> optLevel >> length;
+    if (received && fields && length <= maxSourceLength && readExactly(fd, source, length)) {
+        CompileOptions options;
+        options.optLevel = optLevel > 3 ? 3 : optLevel;
+        options.irFile.clear();
+        options.capturedOutput = &output;
+        compileRequest(source, options, status, diagnostics);
+    } else {
+        diagnostics = "Error: Malformed request\n";
+        status = 1;
+    }
+    _exit(writeResponse(responseFd, status, output, diagnostics) ? 0 : 1);
+}
+
+// the supervisor of one RUN: first tells the pool thread its process group,
+// which the pool thread kills should the supervisor stop answering, then
+// runs the program and reports how it ended
+static void superviseRun(int fd) {
+    signal(SIGCHLD, SIG_DFL); // the runner ignores it; this process waits for its child
+    setpgid(0, 0);
+    if (!writeAll(fd, std::to_string(getpid()) + "\n")) {
+        return;
+    }
+    int pipeFds[2];
+    if (pipe(pipeFds) < 0) {
+        writeResponse(fd, 1, "", std::string("Error: Could not create pipe: ") + std::strerror(errno) + "\n");
+        return;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        writeResponse(fd, 1, "", std::string("Error: Could not fork: ") + std::strerror(errno) + "\n");
+        return;
+    }
+    if (child == 0) {
+        close(pipeFds[0]);
+        runProgram(fd, pipeFds[1]);
+    }
+    close(pipeFds[1]);
+    std::string response;
+    readToEnd(pipeFds[0], response);
+    close(pipeFds[0]);
+    int childStatus = 0;
+    while (waitpid(child, &childStatus, 0) < 0 && errno == EINTR) {
+    }
+    if (WIFSIGNALED(childStatus) && WTERMSIG(childStatus) == SIGALRM) {
+        writeResponse(fd, 1, "", "Error: Program did not finish within " + std::to_string(runTimeoutSeconds) + " seconds\n");
+    } else if (WIFSIGNALED(childStatus)) {
+        // only a complete response is passed on
+        writeResponse(fd, 1, "", std::string("Error: Program terminated by signal ") + strsignal(WTERMSIG(childStatus)) + "\n");
+    } else if (WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0 && !response.empty()) {
+        writeAll(fd, response);
+    } else {
+        writeResponse(fd, 1, "", "Error: Program exited without a response\n");
+    }
+}
+
+// the runner's loop: one supervisor per descriptor received, until the
+// server closes its end
+[[noreturn]] static void runRunner(int controlFd) {
+    signal(SIGCHLD, SIG_IGN); // supervisors are reaped automatically
+    int fd;
+    while ((fd = receiveDescriptor(controlFd)) >= 0) {
+        pid_t supervisor = fork();
+        if (supervisor == 0) {
+            close(controlFd);
+            superviseRun(fd);
+            _exit(0);
+        }
+        close(fd); // on a failed fork too: the pool thread sees it closed
+    }
+    _exit(0);
+}
+
+static void runRequest(int runnerFd, std::string_view source, unsigned optLevel, int& status,
+                       std::string& output, std::string& diagnostics) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        throw std::runtime_error(std::string("Could not create socket pair: ") + std::strerror(errno));
+    }
+    bool sent = sendDescriptor(runnerFd, fds[1]);
+    close(fds[1]);
+    if (!sent) {
+        close(fds[0]);
+        throw std::runtime_error("Could not reach the program runner");
+    }
+    // the supervisor answers within the program's alarm; the margin covers its own work
+    timeval timeout = {static_cast<time_t>(runTimeoutSeconds + 10), 0};
+    setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string groupLine;
+    pid_t group = 0;
+    std::ostringstream header;
+    header << optLevel << " " << source.size() << "\n";
+    bool started = readLine(fds[0], groupLine) && (group = std::atoi(groupLine.c_str())) > 0;
+    bool complete = started && writeAll(fds[0], header.str()) && writeAll(fds[0], source) &&
+                    readResponse(fds[0], status, output, diagnostics);
+    bool timedOut = !complete && (errno == EAGAIN || errno == EWOULDBLOCK);
+    close(fds[0]);
+    if (complete) {
+        return;
+    }
+    output.clear();
+    status = 1;
+    if (!started) {
+        diagnostics = "Error: Could not start the program\n";
+    } else if (timedOut) {
+        kill(-group, SIGKILL); // the supervisor and the program
+        diagnostics = "Error: Program did not respond\n";
+    } else {
+        diagnostics = "Error: Program exited without a response\n";
+    }
+}
+
+static void serveConnection(int fd, int runnerFd, ContextPool& pool, ServerStats& stats) {
+    std::unique_ptr<llvm::LLVMContext> context = pool.acquire();
+    unsigned uses = 0;
+    std::string header;
+    while (readLine(fd, header)) {
+        std::istringstream fields(header);
+        std::string command;
+        unsigned optLevel = 0;
+        size_t length = 0;
+        fields >> command >> optLevel >> length;
+        if (fields && length > maxSourceLength) {
+            writeResponse(fd, 1, "", "Error: Request too large\n");
+            break;
+        }
+        std::string source;
+        if (!fields || !readExactly(fd, source, length)) {
+            writeResponse(fd, 1, "", "Error: Malformed request\n");
+            break;
+        }
+
+        if (command == "STATS") {
+            if (!writeResponse(fd, 0, stats.report(), "")) {
+                break;
+            }
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::string output;
+        std::string diagnostics;
+        int status = 0;
+        if (command == "RUN") {
+            try {
+                runRequest(runnerFd, source, optLevel, status, output, diagnostics);
+            } catch (const std::exception& e) {
+                diagnostics = std::string("Error: ") + e.what() + "\n";
+                status = 1;
+            }
+        } else if (command == "COMPILE") {
+            CompileOptions options;
+            options.optLevel = optLevel > 3 ? 3 : optLevel;
+            options.irFile.clear();
+            options.execute = false;
+            options.context = context.get();
+            compileRequest(source, options, status, diagnostics);
+        } else {
+            diagnostics = "Error: Unknown command: " + command + "\n";
+            status = 1;
+        }
+        uses++;
+        uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        stats.record(micros, status != 0);
+        GEHU_TRACE(Server, Info, command << " request: " << source.size() << " bytes, status " << status
+            << ", " << micros << " us");
+
+        if (!writeResponse(fd, status, output, diagnostics)) {
+            break;
+        }
+        if (uses >= ContextPool::maxUses) {
+            context = std::make_unique<llvm::LLVMContext>();
+            uses = 0;
+        }
+    }
+    pool.release(std::move(context), uses);
+    close(fd);
+}
+
+static bool makeAddress(const std::string& socketPath, sockaddr_un& address) {
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socketPath.c_str());
+    return true;
+}
+
+int runServer(const std::string& socketPath, unsigned workers) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error: Socket path too long: " << socketPath << std::endl;
+        return 1;
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // a client hanging up must not take the server down
+    unlink(socketPath.c_str()); // stale socket from a previous server
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 64) < 0) {
+        std::cerr << "Error: Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return 1;
+    }
+
+    // pay for target initialization once, before the first request
+    CodeGenerator::initializeNativeTarget();
+
+    // the runner must be forked before any other thread exists
+    int runnerFds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, runnerFds) < 0) {
+        std::cerr << "Error: Could not create socket pair: " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        return 1;
+    }
+    pid_t runner = fork();
+    if (runner < 0) {
+        std::cerr << "Error: Could not start the program runner: " << std::strerror(errno) << std::endl;
+        close(runnerFds[0]);
+        close(runnerFds[1]);
+        close(listenFd);
+        return 1;
+    }
+    if (runner == 0) {
+        close(listenFd);
+        close(runnerFds[0]);
+        runRunner(runnerFds[1]);
+    }
+    close(runnerFds[1]);
+    int runnerFd = runnerFds[0];
+    GEHU_TRACE(Server, Info, "Listening on " << socketPath);
+
+    // A fixed pool of threads accepts and serves connections, one at a time
+    // each; further clients wait in the listen backlog until one is free
+    ContextPool pool;
+    ServerStats stats;
+    auto acceptLoop = [&]() {
+        while (true) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                GEHU_TRACE(Server, Info, "accept failed: " << std::strerror(errno));
+                return;
+            }
+            // a failure in one connection closes only that connection
+            try {
+                serveConnection(fd, runnerFd, pool, stats);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: connection failed: " << e.what() << std::endl;
+                close(fd);
+            }
+        }
+    };
+    if (workers == 0) {
+        workers = std::max(4u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < workers; i++) {
+        threads.emplace_back(acceptLoop);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+    close(listenFd);
+    close(runnerFd); // the runner exits when its end is closed
+    waitpid(runner, nullptr, 0);
+    return 1;
+}
+
+int runClient(const std::string& socketPath, const std::string& command, std::string_view source, unsigned optLevel) {
+    sockaddr_un address;
+    if (!makeAddress(socketPath, address)) {
+        std::cerr << "Error: Socket path too long: " << socketPath << std::endl;
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Error: Could not connect to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+
+    std::ostringstream header;
+    header << command << " " << optLevel << " " << source.size() << "\n";
+    int status = 1;
+    std::string output;
+    std::string diagnostics;
+    bool ok = writeAll(fd, header.str()) && writeAll(fd, source) && readResponse(fd, status, output, diagnostics);
+    close(fd);
+    if (!ok) {
+        std::cerr << "Error: Lost connection to " << socketPath << std::endl;
+        return 1;
+    }
+    std::cout << output << std::flush;
+    std::cerr << diagnostics << std::flush;
+    return status;
+}
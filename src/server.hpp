@@ -0,0 +1,18 @@
+//Compile server
+//gehu --serve keeps LLVM initialized in a resident process and compiles or
+//runs programs sent over a Unix domain socket; gehu --client is a thin
+//replacement for the normal command line that forwards to it
+//
+//Request:  <RUN|COMPILE|STATS> <optLevel> <sourceLength>\n<source>
+//Response: <status> <stdoutLength> <diagnosticsLength>\n<stdout><diagnostics>
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// serves up to workers connections at once (0: one per core, at least 4);
+// each RUN executes in a process of its own, so a faulting program cannot crash it
+int runServer(const std::string& socketPath, unsigned workers);
+
+// returns the exit status for the client process
+int runClient(const std::string& socketPath, const std::string& command, std::string_view source, unsigned optLevel);
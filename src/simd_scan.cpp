@@ -0,0 +1,124 @@
+#include "simd_scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2 and AVX2 intrinsics
+#define GEHU_SCAN_X86 1
+#endif
+
+namespace scan {
+
+namespace {
+
+// Which bytes a kernel stops at. Whitespace stops at anything that is not
+// blank; findByte stops at one byte value.
+enum class Mode { Whitespace, Byte };
+
+inline bool stopsAt(Mode mode, char c, char stop) {
+    if (mode == Mode::Whitespace) {
+        return c != ' ' && c != '\t' && c != '\n';
+    }
+    return c == stop;
+}
+
+size_t scanScalar(Mode mode, const char* data, size_t length, char stop, size_t offset) {
+    for (size_t i = offset; i < length; i++) {
+        if (stopsAt(mode, data[i], stop)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+#ifdef GEHU_SCAN_X86
+
+__attribute__((target("sse2")))
+size_t scanSSE2(Mode mode, const char* data, size_t length, char stop) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i target = _mm_set1_epi8(stop);
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned stopMask;
+        if (mode == Mode::Whitespace) {
+            __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, newline),
+                _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab)));
+            stopMask = ~static_cast<unsigned>(_mm_movemask_epi8(blank)) & 0xFFFF;
+        } else {
+            stopMask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, target)));
+        }
+        if (stopMask) {
+            return i + __builtin_ctz(stopMask);
+        }
+    }
+    return scanScalar(mode, data, length, stop, i);
+}
+
+__attribute__((target("avx2")))
+size_t scanAVX2(Mode mode, const char* data, size_t length, char stop) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i target = _mm256_set1_epi8(stop);
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned stopMask;
+        if (mode == Mode::Whitespace) {
+            __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, newline),
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab)));
+            stopMask = ~static_cast<unsigned>(_mm256_movemask_epi8(blank));
+        } else {
+            stopMask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target)));
+        }
+        if (stopMask) {
+            return i + __builtin_ctz(stopMask);
+        }
+    }
+    return scanScalar(mode, data, length, stop, i);
+}
+
+#endif
+
+size_t scanPortable(Mode mode, const char* data, size_t length, char stop) {
+    return scanScalar(mode, data, length, stop, 0);
+}
+
+using Kernel = size_t (*)(Mode, const char*, size_t, char);
+
+struct Selected {
+    Kernel kernel;
+    const char* name;
+};
+
+Selected selectKernel() {
+#ifdef GEHU_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {scanAVX2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return {scanSSE2, "sse2"};
+    }
+#endif
+    return {scanPortable, "scalar"};
+}
+
+const Selected selected = selectKernel();
+
+} // namespace
+
+size_t skipWhitespace(const char* data, size_t length) {
+    return selected.kernel(Mode::Whitespace, data, length, '\0');
+}
+
+size_t findByte(const char* data, size_t length, char stop) {
+    return selected.kernel(Mode::Byte, data, length, stop);
+}
+
+const char* kernelName() {
+    return selected.name;
+}
+
+} // namespace scan
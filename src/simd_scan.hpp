@@ -0,0 +1,24 @@
+//Byte scanning kernels for the lexer
+//Each kernel looks for the next interesting byte 16 (SSE2) or 32 (AVX2)
+//bytes at a time instead of one character per step.
+//The widest kernel the CPU supports is picked at startup, with a scalar
+//fallback on other architectures.
+#pragma once
+
+#include <cstddef>
+
+namespace scan {
+
+// Both return the number of bytes skipped, which is the whole length when
+// nothing stops the scan.
+
+// skip spaces, tabs and newlines
+size_t skipWhitespace(const char* data, size_t length);
+
+// skip up to (not including) the first occurrence of stop
+size_t findByte(const char* data, size_t length, char stop);
+
+// name of the kernel in use: "avx2", "sse2" or "scalar"
+const char* kernelName();
+
+} // namespace scan
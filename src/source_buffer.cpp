@@ -0,0 +1,20 @@
+#include "source_buffer.hpp"
+#include "trace.hpp"
+#include <stdexcept>
+
+SourceBuffer::SourceBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer, std::string name)
+    : buffer(std::move(buffer)), bufferName(std::move(name)) {}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string& path) {
+    // no terminator is needed (the lexer is bounded by the length), which
+    // lets LLVM map any regular file that is not tiny
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+        llvm::MemoryBuffer::getFileOrSTDIN(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    std::unique_ptr<SourceBuffer> source(new SourceBuffer(std::move(*buffer), path));
+    GEHU_TRACE(Driver, Debug, "Loaded " << path << ": " << source->text().size() << " bytes, "
+        << (source->isMapped() ? "mapped" : "read"));
+    return source;
+}
@@ -0,0 +1,26 @@
+//SourceBuffer class definition
+//SourceBuffer holds the bytes of one source file. Regular files are
+//memory-mapped so the lexer works on the page cache directly; small files,
+//pipes and standard input ("-") are read into memory instead.
+#pragma once
+
+#include <llvm/Support/MemoryBuffer.h> // for the mapping
+#include <memory>
+#include <string>
+#include <string_view>
+
+class SourceBuffer {
+public:
+    // throws std::runtime_error when the file cannot be read
+    static std::unique_ptr<SourceBuffer> fromFile(const std::string& path);
+
+    std::string_view text() const { return {buffer->getBufferStart(), buffer->getBufferSize()}; }
+    const std::string& name() const { return bufferName; }
+    bool isMapped() const { return buffer->getBufferKind() == llvm::MemoryBuffer::MemoryBuffer_MMap; }
+
+private:
+    SourceBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer, std::string name);
+
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    std::string bufferName;
+};
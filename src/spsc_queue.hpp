@@ -0,0 +1,50 @@
+//SpscQueue class definition
+//SpscQueue is a bounded lock-free queue between exactly one producer thread
+//and one consumer thread. Elements live in place in a fixed ring: the
+//producer fills the slot returned by producerSlot() and publishes it with
+//push(), the consumer reads consumerSlot() and releases it with pop(), so
+//large elements such as token batches are reused rather than moved.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // the slot to fill next, or nullptr when the queue is full
+    T* producerSlot() {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - headIndex.load(std::memory_order_acquire) == Capacity) {
+            return nullptr;
+        }
+        return &slots[tail & (Capacity - 1)];
+    }
+
+    // publish the slot returned by producerSlot()
+    void push() {
+        tailIndex.store(tailIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // the oldest published slot, or nullptr when the queue is empty
+    T* consumerSlot() {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == tailIndex.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &slots[head & (Capacity - 1)];
+    }
+
+    // hand the slot returned by consumerSlot() back to the producer
+    void pop() {
+        headIndex.store(headIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    T slots[Capacity];
+    // on separate cache lines so the two threads do not invalidate each other
+    alignas(64) std::atomic<size_t> headIndex{0}; // written by the consumer
+    alignas(64) std::atomic<size_t> tailIndex{0}; // written by the producer
+};
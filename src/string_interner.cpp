@@ -0,0 +1,62 @@
+#include "string_interner.hpp"
+#include <cstring> // for memcpy
+
+static constexpr size_t arenaBlockSize = 64 * 1024;
+
+// FNV-1a; identifiers are short, so a simple byte loop is enough
+static uint32_t hashText(std::string_view text) {
+    uint32_t hash = 2166136261u;
+    for (char c : text) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+StringInterner::StringInterner() : slots(64, 0), blockUsed(0), blockSize(0) {}
+
+Symbol StringInterner::intern(std::string_view text) {
+    uint32_t hash = hashText(text);
+    size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t entry = slots[slot];
+        if (entry == 0) {
+            Symbol symbol = static_cast<Symbol>(spellings.size());
+            spellings.emplace_back(store(text), text.size());
+            hashes.push_back(hash);
+            slots[slot] = symbol + 1;
+            // keep the table at most half full so probes stay short
+            if (spellings.size() * 2 > slots.size()) {
+                grow();
+            }
+            return symbol;
+        }
+        if (hashes[entry - 1] == hash && spellings[entry - 1] == text) {
+            return entry - 1;
+        }
+    }
+}
+
+const char* StringInterner::store(std::string_view text) {
+    if (blocks.empty() || blockUsed + text.size() > blockSize) {
+        blockSize = text.size() > arenaBlockSize ? text.size() : arenaBlockSize;
+        blocks.push_back(std::make_unique<char[]>(blockSize));
+        blockUsed = 0;
+    }
+    char* copy = blocks.back().get() + blockUsed;
+    std::memcpy(copy, text.data(), text.size());
+    blockUsed += text.size();
+    return copy;
+}
+
+void StringInterner::grow() {
+    std::vector<uint32_t> larger(slots.size() * 2, 0);
+    size_t mask = larger.size() - 1;
+    for (Symbol symbol = 0; symbol < spellings.size(); symbol++) {
+        size_t slot = hashes[symbol] & mask;
+        while (larger[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        larger[slot] = symbol + 1;
+    }
+    slots.swap(larger);
+}
@@ -0,0 +1,33 @@
+//StringInterner class definition
+//StringInterner gives every distinct identifier of a compilation a dense
+//32-bit symbol ID. The lexer interns identifiers as it scans them, so later
+//phases compare and index by ID and only turn an ID back into its spelling
+//for diagnostics and IR names.
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using Symbol = uint32_t;
+
+class StringInterner {
+public:
+    StringInterner();
+    Symbol intern(std::string_view text);
+    std::string_view spelling(Symbol symbol) const { return spellings[symbol]; }
+    size_t size() const { return spellings.size(); } // symbols are 0 .. size() - 1
+
+private:
+    const char* store(std::string_view text); // copy into the arena
+    void grow();
+
+    // open addressing over symbols; a slot holds symbol + 1, or 0 when empty
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> hashes; // indexed by symbol, to skip most string compares
+    std::vector<std::string_view> spellings; // indexed by symbol
+    std::vector<std::unique_ptr<char[]>> blocks; // arena holding the spellings
+    size_t blockUsed;
+    size_t blockSize;
+};
@@ -0,0 +1,47 @@
+#include "token_stream.hpp"
+#include "errors.hpp"
+
+TokenStream::TokenStream(TokenProducer& producer, std::string_view source)
+    : producer(producer), source(source), head(0), tail(0), finished(false) {}
+
+const Token& TokenStream::peek(size_t ahead) {
+    if (ahead >= maxLookahead) {
+        throw ParserError("Lookahead of " + std::to_string(ahead) + " tokens is too far", 0, 0);
+    }
+    while (head + ahead >= tail) {
+        if (finished) {
+            return ring[(tail - 1) & mask]; // the EOF token
+        }
+        refill();
+    }
+    return ring[(head + ahead) & mask];
+}
+
+const Token& TokenStream::advance() {
+    if (peek().type != TokenType::EOF_TOKEN) { // never step past EOF
+        head++;
+    }
+    return previous();
+}
+
+// Fill the free part of the ring in one call to the producer, keeping the
+// previous token intact; the part up to the wrap point is filled first
+void TokenStream::refill() {
+    size_t keep = head > 0 ? 1 : 0;
+    size_t free = capacity - (tail - head) - keep;
+    size_t start = tail & mask;
+    size_t count = capacity - start < free ? capacity - start : free;
+    size_t produced = producer.fill(&ring[start], count);
+    if (produced == 0) {
+        throw ParserError("Token producer ended without an EOF token", 0, 0);
+    }
+    tail += produced;
+    finished = ring[(tail - 1) & mask].type == TokenType::EOF_TOKEN;
+}
+
+SourceLocation TokenStream::location(const Token& token) const {
+    if (!lineIndex) {
+        lineIndex = std::make_unique<LineIndex>(source);
+    }
+    return lineIndex->locate(token.offset);
+}
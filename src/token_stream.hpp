@@ -0,0 +1,42 @@
+//TokenStream class definition
+//TokenStream hands the parser tokens pulled from a TokenProducer (normally
+//the lexer) through a small ring buffer, so tokens are never collected for
+//the whole file. It keeps the previous token and a bounded lookahead, and
+//recovers token text and positions from the source on demand.
+#pragma once
+
+#include "lexer.hpp"
+#include "line_index.hpp"
+#include <memory>
+#include <string_view>
+
+class TokenStream {
+public:
+    static constexpr size_t capacity = 64; // ring size, a power of two
+    static constexpr size_t maxLookahead = capacity / 2;
+
+    TokenStream(TokenProducer& producer, std::string_view source);
+
+    // References stay valid until the next peek or advance; copy a token to
+    // keep it longer. Past the end, peek keeps returning the EOF token.
+    const Token& peek(size_t ahead = 0);
+    const Token& previous() const { return ring[(head - 1) & mask]; }
+    const Token& advance(); // consumes the current token and returns it
+
+    size_t consumed() const { return head; }
+    std::string_view text(const Token& token) const { return source.substr(token.offset, token.length); }
+    SourceLocation location(const Token& token) const;
+
+private:
+    static constexpr size_t mask = capacity - 1;
+
+    void refill();
+
+    TokenProducer& producer;
+    std::string_view source;
+    Token ring[capacity];
+    size_t head; // tokens consumed so far; ring[head & mask] is the current token
+    size_t tail; // tokens produced so far
+    bool finished; // the producer has delivered EOF
+    mutable std::unique_ptr<LineIndex> lineIndex; // built for the first diagnostic
+};
@@ -0,0 +1,130 @@
+#include "trace.hpp"
+#include <cstdio> // for the trace sink
+#include <cstdlib> // for atexit
+#include <mutex>
+
+namespace trace {
+
+unsigned enabledCategories[2] = {0, 0};
+
+namespace {
+
+struct CategoryName {
+    const char* name;
+    TraceCategory category;
+};
+
+const CategoryName categoryNames[] = {
+    {"driver", TraceCategory::Driver},
+    {"lexer", TraceCategory::Lexer},
+    {"parser", TraceCategory::Parser},
+    {"sema", TraceCategory::Sema},
+    {"codegen", TraceCategory::CodeGen},
+    {"jit", TraceCategory::JIT},
+    {"cache", TraceCategory::Cache},
+    {"server", TraceCategory::Server},
+};
+
+const size_t flushThreshold = 64 * 1024;
+
+// messages are batched here and written in large chunks; a mutex keeps lines
+// from batch workers and server connections whole
+std::mutex sinkMutex;
+std::string buffer;
+FILE* sink = nullptr;
+
+const char* nameOf(TraceCategory category) {
+    for (const CategoryName& entry : categoryNames) {
+        if (entry.category == category) {
+            return entry.name;
+        }
+    }
+    return "trace";
+}
+
+void flushLocked() {
+    if (!buffer.empty()) {
+        std::fwrite(buffer.data(), 1, buffer.size(), sink ? sink : stderr);
+        std::fflush(sink ? sink : stderr);
+        buffer.clear();
+    }
+}
+
+} // namespace
+
+bool enable(const std::string& categories) {
+    unsigned info = 0;
+    unsigned debug = 0;
+    size_t start = 0;
+    while (start <= categories.size()) {
+        size_t end = categories.find(',', start);
+        if (end == std::string::npos) {
+            end = categories.size();
+        }
+        std::string name = categories.substr(start, end - start);
+        bool debugLevel = true;
+        size_t colon = name.find(':');
+        if (colon != std::string::npos) {
+            std::string level = name.substr(colon + 1);
+            if (level == "info") {
+                debugLevel = false;
+            } else if (level != "debug") {
+                return false;
+            }
+            name.resize(colon);
+        }
+
+        unsigned mask = 0;
+        for (const CategoryName& entry : categoryNames) {
+            if (name == entry.name || name == "all") {
+                mask |= static_cast<unsigned>(entry.category);
+            }
+        }
+        if (mask == 0) {
+            return false;
+        }
+        info |= mask;
+        if (debugLevel) {
+            debug |= mask;
+        }
+        start = end + 1;
+    }
+    enabledCategories[static_cast<unsigned>(TraceLevel::Info)] = info;
+    enabledCategories[static_cast<unsigned>(TraceLevel::Debug)] = debug;
+    static bool registered = false;
+    if (!registered) {
+        std::atexit(flush);
+        registered = true;
+    }
+    return true;
+}
+
+bool setOutputFile(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    flushLocked();
+    sink = file;
+    return true;
+}
+
+void write(TraceCategory category, const std::string& message) {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    buffer += '[';
+    buffer += nameOf(category);
+    buffer += "] ";
+    buffer += message;
+    buffer += '\n';
+    if (buffer.size() >= flushThreshold) {
+        flushLocked();
+    }
+}
+
+void flush() {
+    std::lock_guard<std::mutex> lock(sinkMutex);
+    flushLocked();
+}
+
+} // namespace trace
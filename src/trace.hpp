@@ -0,0 +1,66 @@
+//Tracing
+//Leveled, per-subsystem tracing for compiler internals. Messages go to a
+//buffered sink separate from program stdout (stderr, or --trace-file), and
+//are selected at runtime with --trace=lexer,codegen,... (every level) or
+//--trace=codegen:info (phase level messages only)
+//
+//GEHU_TRACE compiles to nothing unless GEHU_ENABLE_TRACING is defined, which
+//is the default for builds without NDEBUG (i.e. everything but release builds)
+#pragma once
+
+#include <sstream> // for building trace messages
+#include <string>
+
+#if !defined(NDEBUG) && !defined(GEHU_ENABLE_TRACING)
+#define GEHU_ENABLE_TRACING
+#endif
+
+enum class TraceCategory : unsigned {
+    Driver = 1u << 0,
+    Lexer = 1u << 1,
+    Parser = 1u << 2,
+    Sema = 1u << 3,
+    CodeGen = 1u << 4,
+    JIT = 1u << 5,
+    Cache = 1u << 6,
+    Server = 1u << 7,
+};
+
+enum class TraceLevel : unsigned {
+    Info, // phases and other coarse progress
+    Debug, // per token, per AST node
+};
+
+namespace trace {
+
+// bitmask of enabled categories per level, written once while parsing the command line
+extern unsigned enabledCategories[2];
+
+inline bool isEnabled(TraceCategory category, TraceLevel level) {
+    return (enabledCategories[static_cast<unsigned>(level)] & static_cast<unsigned>(category)) != 0;
+}
+
+// enable a comma separated list of category[:level] names ("all" for every
+// category); returns false and leaves nothing enabled if a name is unknown
+bool enable(const std::string& categories);
+
+// send trace output to a file instead of stderr
+bool setOutputFile(const std::string& filename);
+
+void write(TraceCategory category, const std::string& message);
+void flush();
+
+} // namespace trace
+
+#ifdef GEHU_ENABLE_TRACING
+#define GEHU_TRACE(category, level, message)                                  \
+    do {                                                                      \
+        if (trace::isEnabled(TraceCategory::category, TraceLevel::level)) {   \
+            std::ostringstream gehuTraceStream;                               \
+            gehuTraceStream << message;                                       \
+            trace::write(TraceCategory::category, gehuTraceStream.str());     \
+        }                                                                     \
+    } while (0)
+#else
+#define GEHU_TRACE(category, level, message) do { } while (0)
+#endif
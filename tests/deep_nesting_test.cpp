@@ -0,0 +1,98 @@
+//Deep nesting test
+//Machine-generated Gehu can nest far deeper than the native stack allows
+//recursion. Each case below nests a million levels deep (or the depth given
+//as the first argument) and goes through both parsers, semantic analysis
+//and code generation for both AST forms, all of which walk explicit stacks.
+#include "../src/lexer.hpp"
+#include "../src/token_stream.hpp"
+#include "../src/parser.hpp"
+#include "../src/semantic_analyzer.hpp"
+#include "../src/codegen.hpp"
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+
+static std::string repeat(const std::string& text, size_t count) {
+    std::string result;
+    result.reserve(text.size() * count);
+    for (size_t i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+struct TestCase {
+    const char* name;
+    std::function<std::string(size_t)> generate;
+};
+
+// every case is a complete program whose deep part refers back to x
+static const TestCase cases[] = {
+    {"nested parentheses", [](size_t depth) {
+        return "let x = 1;\nlet y = " + repeat("(", depth) + "x" + repeat(" + 1)", depth) + ";\nshow y;\n";
+    }},
+    {"unary minus chain", [](size_t depth) {
+        return "let x = 1;\nlet y = " + repeat("-", depth) + "x;\nshow y;\n";
+    }},
+    {"binary + chain", [](size_t depth) {
+        return "let x = 1;\nlet y = x" + repeat(" + 1", depth) + ";\nshow y;\n";
+    }},
+    {"nested if/else", [](size_t depth) {
+        return "let x = 1;\n" + repeat("if (x > 0) { x = x + 1; ", depth) + "let y = x; show y;"
+            + repeat("} else { show x; }", depth) + "\nshow x;\n";
+    }},
+};
+
+// parse, analyze and generate IR for one program; returns the node count
+static size_t compileTree(const std::string& source, StringInterner& symbols) {
+    Lexer lexer(source, symbols);
+    TokenStream tokens(lexer, source);
+    ASTContext context;
+    TreeBuilder builder(context);
+    Program* program = Parser(tokens, builder).parse();
+    SemanticAnalyzer(symbols).analyze(program);
+    CodeGenerator codegen;
+    codegen.generate(program, symbols);
+    codegen.verify();
+    return countNodes(program);
+}
+
+// the same through the flat AST; returns the slot count
+static size_t compileFlat(const std::string& source, StringInterner& symbols) {
+    Lexer lexer(source, symbols);
+    TokenStream tokens(lexer, source);
+    FlatAST ast;
+    FlatBuilder builder(ast);
+    FlatParser(tokens, builder).parse();
+    SemanticAnalyzer(symbols).analyze(ast);
+    CodeGenerator codegen;
+    codegen.generate(ast, symbols);
+    codegen.verify();
+    return ast.size();
+}
+
+int main(int argc, char** argv) {
+    size_t depth = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    int failures = 0;
+    for (const TestCase& test : cases) {
+        std::string source = test.generate(depth);
+        StringInterner symbols;
+        try {
+            size_t treeNodes = compileTree(source, symbols);
+            size_t flatSlots = compileFlat(source, symbols);
+            // the flat form has one more slot, for the program's root block
+            if (flatSlots != treeNodes + 1) {
+                std::cerr << "FAIL " << test.name << ": " << treeNodes << " tree nodes but "
+                          << flatSlots << " flat slots" << std::endl;
+                failures++;
+                continue;
+            }
+            std::cout << "PASS " << test.name << " (depth " << depth << ", " << treeNodes << " nodes)" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "FAIL " << test.name << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+//If condition test
+//An if takes any number as its condition, not only a comparison: integers
+//and doubles branch on being non-zero, and a string is a code generation
+//error. Each case goes through code generation for both AST forms, and the
+//module has to verify.
+#include "../src/lexer.hpp"
+#include "../src/token_stream.hpp"
+#include "../src/parser.hpp"
+#include "../src/semantic_analyzer.hpp"
+#include "../src/codegen.hpp"
+#include <iostream>
+#include <string>
+
+struct TestCase {
+    const char* name;
+    const char* source;
+    bool rejected; // expected to throw the CodeGenError for a bad condition
+};
+
+static const TestCase cases[] = {
+    {"comparison", "let x = 3;\nif (x > 1) { show x; }\n", false},
+    {"integer variable", "let x = 3;\nif (x) { show x; } else { show 0; }\n", false},
+    {"bitwise and", "let x = 3;\nif (x & 1) { show x; }\n", false},
+    {"unary minus", "let x = 3;\nif (-x) { show x; }\n", false},
+    {"arithmetic on comparisons", "let x = 3;\nif ((x > 1) + (x < 5)) { show x; }\n", false},
+    {"double literal", "if (1.5) { show 1; }\n", false},
+    {"double variable", "let d = 0.5;\nif (d) { show d; } else { show 0; }\n", false},
+    {"string literal", "if (\"yes\") { show 1; }\n", true},
+    {"string variable", "let s = \"yes\";\nif (s) { show s; }\n", true},
+};
+
+static void compileTree(const std::string& source, StringInterner& symbols) {
+    Lexer lexer(source, symbols);
+    TokenStream tokens(lexer, source);
+    ASTContext context;
+    TreeBuilder builder(context);
+    Program* program = Parser(tokens, builder).parse();
+    SemanticAnalyzer(symbols).analyze(program);
+    CodeGenerator codegen;
+    codegen.generate(program, symbols);
+    codegen.verify();
+}
+
+static void compileFlat(const std::string& source, StringInterner& symbols) {
+    Lexer lexer(source, symbols);
+    TokenStream tokens(lexer, source);
+    FlatAST ast;
+    FlatBuilder builder(ast);
+    FlatParser(tokens, builder).parse();
+    SemanticAnalyzer(symbols).analyze(ast);
+    CodeGenerator codegen;
+    codegen.generate(ast, symbols);
+    codegen.verify();
+}
+
+// runs one AST form; returns an empty string when the outcome is the expected one
+static std::string check(const TestCase& test, void (*compile)(const std::string&, StringInterner&)) {
+    StringInterner symbols;
+    try {
+        compile(test.source, symbols);
+    } catch (const CodeGenError& e) {
+        // a failed verification is a CodeGenError too, so the message is checked
+        bool badCondition = std::string(e.what()).find("If condition") != std::string::npos;
+        return test.rejected && badCondition ? "" : e.what();
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return test.rejected ? "expected a CodeGenError" : "";
+}
+
+int main() {
+    int failures = 0;
+    for (const TestCase& test : cases) {
+        std::string treeError = check(test, compileTree);
+        std::string flatError = check(test, compileFlat);
+        if (!treeError.empty() || !flatError.empty()) {
+            std::cerr << "FAIL " << test.name << ": "
+                      << (treeError.empty() ? "" : "tree: " + treeError + " ")
+                      << (flatError.empty() ? "" : "flat: " + flatError) << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << "PASS " << test.name << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}